@@ -0,0 +1,275 @@
+// ray marching shared by the fragment and compute ray shaders, a compute shader defines
+// SHARED_RAY_STACK as its work group size to keep the ray stacks in shared memory
+#define EPSILON 1e-6f
+#define RFR_OFFSET 1e-4
+#define RFL_OFFSET 1e-5
+#define TWO_PI 6.28318530718f
+
+uniform vec2 viewport_size;
+// position of the rendered tile on the canvas, 0 unless rendering out of core
+uniform vec2 tile_origin;
+
+// radius and luminance are constants of the generated scene
+struct light_source
+{
+	vec2 position;
+};
+
+uniform light_source light1;
+
+uniform uvec2 noise_size;
+
+uniform int rangle[SAMPLE];
+layout (location = 0)uniform sampler2D noise_map;
+
+struct ray
+{
+	vec2 position;
+	vec2 direction;
+	vec3 coefficient;
+	int depth;	
+};
+
+// use stack buffer to store rays for iterations and solve ray marching without recursions
+// max buffer size equals max reflection/refraction depth
+// with RGB colored ray, need to plus 2 to buffer size to accommodate refrected rays
+#define RAY_STACK_SIZE (RAY_DEPTH + 2)
+#ifdef SHARED_RAY_STACK
+shared ray ray_stack[SHARED_RAY_STACK][RAY_STACK_SIZE];
+#define RAY_STACK(i) ray_stack[gl_LocalInvocationIndex][i]
+#else
+ray ray_buffer[RAY_STACK_SIZE];
+#define RAY_STACK(i) ray_buffer[i]
+#endif
+#define MARCH_STEPS 64
+
+#ifdef PROFILE
+// per pixel cost of the pass, added to the profile buffer by profile_store, the counters and
+// every update of them are compiled out unless the renderer builds a profiling variant
+layout (std430, binding = 2) buffer profile_buffer
+{
+	uint profile[];
+};
+// pixels per row of the profile buffer
+uniform int profile_width;
+uint profile_steps = 0;
+uint profile_scene_calls = 0;
+uint profile_max_depth = 0;
+uint profile_pushes = 0;
+uint profile_exhausted = 0;
+#define PROFILE_ADD(counter, n) counter += uint(n)
+#define PROFILE_MAX(counter, n) counter = max(counter, uint(n))
+
+// counters in ProfileCounter order, a pixel is only written by one invocation per pass
+void profile_store(ivec2 pixel)
+{
+	int i = (pixel.y * profile_width + pixel.x) * 5;
+	profile[i] += profile_steps;
+	profile[i + 1] += profile_scene_calls;
+	profile[i + 2] = max(profile[i + 2], profile_max_depth);
+	profile[i + 3] += profile_pushes;
+	profile[i + 4] += profile_exhausted;
+}
+#else
+#define PROFILE_ADD(counter, n)
+#define PROFILE_MAX(counter, n)
+#endif
+
+// a white ray can split into four rays at a hit, pushes onto a full stack are dropped
+// instead of overwriting the neighbouring stack in shared memory
+#define PUSH_RAY(r) if (k < RAY_STACK_SIZE - 1) \
+	{ \
+		RAY_STACK(++k) = r; \
+		PROFILE_ADD(profile_pushes, 1); \
+		PROFILE_MAX(profile_max_depth, k + 1); \
+	}
+
+struct result
+{
+	float signed_dist;
+	vec3 emissive;
+	vec3 reflective; // r0
+	vec3 refractive;
+	vec3 absorption;
+};
+
+
+#include "sdf.glsl"
+
+result union_op(result a, result b)
+{
+	return a.signed_dist < b.signed_dist ? a : b;
+}
+
+result intersect_op(result a, result b)
+{
+	return a.signed_dist < b.signed_dist ? b : a;
+}
+
+result subtract_op(result a, result b)
+{
+	b.signed_dist = -b.signed_dist;
+	return a.signed_dist < b.signed_dist ? b : a;
+}
+
+// generated from the scene description with every object inlined as constants,
+// defines result scene(float x, float y) and its distance only float scene_distance(float x, float y)
+#include "scene.glsl"
+
+vec2 normal(float x, float y)
+{
+	float dx = (scene_distance(x + EPSILON, y) - scene_distance(x - EPSILON, y)) / (EPSILON * 2);
+	float dy = (scene_distance(x, y + EPSILON) - scene_distance(x, y - EPSILON)) / (EPSILON * 2);
+	vec2 n = normalize(vec2(dx, dy));
+	PROFILE_ADD(profile_scene_calls, 4);
+	return n;
+}
+
+vec2 _reflect(vec2 i, vec2 n)
+{
+	return i - 2 * dot(i, n) * n;
+}
+
+vec3 beerLambert(vec3 a, float d) {
+    return vec3(exp(-a.x * d), exp(-a.y * d), exp(-a.z * d));
+}
+
+float fresnelSchlick(float r0, float cos_i) {
+    float a = 1.0f - cos_i;
+    float aa = a * a;
+    return r0 + (1.0f - r0) * aa * aa * a;
+}
+
+vec3 march()
+{
+	vec3 e = vec3(0);
+	int k = 0;
+
+	do
+	{
+		// pop ray from stack
+		ray ra = RAY_STACK(k--);
+
+		vec2 o = ra.position;
+		float t = 0;
+		float s = scene_distance(o.x, o.y) > 0 ? 1 : -1;		
+		PROFILE_ADD(profile_scene_calls, 1);
+		int i = 0;
+		for (; i < MARCH_STEPS && t < 2; i++)
+		{		
+			vec2 p = o + ra.direction * t;
+
+			// materials are only looked up at hits
+			float d = scene_distance(p.x, p.y);
+			PROFILE_ADD(profile_steps, 1);
+			PROFILE_ADD(profile_scene_calls, 1);
+			if (s * d < EPSILON)
+			{
+				result r = scene(p.x, p.y);
+				PROFILE_ADD(profile_scene_calls, 1);
+				if (s < 0)
+				{
+					ra.coefficient *=  beerLambert(r.absorption, t);
+				}				
+				e += r.emissive * ra.coefficient;				
+				if (ra.depth > 0)
+				{
+					vec2 n = s * normal(p.x, p.y);
+					vec3 eta = s < 0 ? r.refractive : 1 / r.refractive;
+					float cos_i = -dot(ra.direction, n);
+
+					if (ra.coefficient[0] > 0 && r.refractive[0] > 0)
+					{
+						vec2 rf = refract(ra.direction, n, eta[0]);
+						if (rf == vec2(0))
+						{
+							r.reflective[0] = 1; // total internal reflection
+						}
+						else
+						{
+							r.reflective[0] = fresnelSchlick(r.reflective[0], eta[0] < 1 ? cos_i : -dot(rf, n));
+							vec3 c = vec3(1 - r.reflective[0], 0, 0);							
+							PUSH_RAY(ray(p + rf * RFR_OFFSET, rf, ra.coefficient * c, ra.depth - 1));
+						} 
+					}
+
+					if (ra.coefficient[1] > 0 && r.refractive[1] > 0)
+					{
+						vec2 rf = refract(ra.direction, n, eta[1]);
+						if (rf == vec2(0))
+						{
+							r.reflective[1] = 1; // total internal reflection
+						}
+						else
+						{
+							r.reflective[1] = fresnelSchlick(r.reflective[1], eta[1] < 1 ? cos_i : -dot(rf, n));
+							vec3 c = vec3(0, 1 - r.reflective[1], 0);							
+							PUSH_RAY(ray(p + rf * RFR_OFFSET, rf, ra.coefficient * c, ra.depth - 1));
+						} 
+					}
+
+					if (ra.coefficient[2] > 0 && r.refractive[2] > 0)
+					{
+						vec2 rf = refract(ra.direction, n, eta[2]);
+						if (rf == vec2(0))
+						{
+							r.reflective[2] = 1; // total internal reflection
+						}
+						else
+						{
+							r.reflective[2] = fresnelSchlick(r.reflective[2], eta[2] < 1 ? cos_i : -dot(rf, n));
+							vec3 c = vec3(0, 0, 1 - r.reflective[2]);							
+							PUSH_RAY(ray(p + rf * RFR_OFFSET, rf, ra.coefficient * c, ra.depth - 1));
+						} 
+					}
+
+					if (length(r.reflective) > 0)
+					{
+						vec2 rf = reflect(ra.direction, n);
+					
+						// push reflection ray to stack
+						PUSH_RAY(ray(p + rf * RFL_OFFSET, rf, ra.coefficient * r.reflective, ra.depth - 1));
+					}					
+				}
+				break;
+			}			
+			t += s * d;
+		}		
+		// the ray neither hit anything nor left the scene
+		PROFILE_ADD(profile_exhausted, i == MARCH_STEPS && t < 2);
+	} while (k >= 0);
+	return e;
+}
+
+
+// pos in scene units, noise_coord the canvas pixel used to look up the noise offset
+vec3 ray_sample(vec2 pos, vec2 noise_coord)
+{
+	vec3 emissive = vec3(0);
+//	float noise = texture(noise_map, (gl_FragCoord.xy + iteration) / noise_size).x;
+//	for (int i = 0; i < SAMPLE; i++)
+//	{
+//		float angle = TWO_PI * (i * 16 + (iteration + 1) / 2 * (1 - ((iteration + 1) % 2) * 2) + noise) / 256;//SAMPLE;
+//		//float angle = (i + noise);
+//		//float a =  (i + texture2D(texture1, gl_FragCoord.xy / noise_size).x);
+//		//float a =  2*3.1415926 *(i + o*1 + 0*  LFSR_Rand_Gen(pos)) / 64;
+//		// push sample ray to stack for ray marching
+//		RAY_STACK(0) = ray(pos, vec2(cos(angle), sin(angle)), 1, RAY_DEPTH);
+//		emissive += march();
+//	}
+
+	float noise = texture(noise_map, noise_coord / noise_size).x;
+	for (int i = 0; i < SAMPLE; i++)
+	{	
+		float angle = TWO_PI * (rangle[i] + noise) / (SAMPLE * ITERATION);
+		//float angle = (i + noise);
+		//float a =  (i + texture2D(texture1, gl_FragCoord.xy / noise_size).x);
+		//float a =  2*3.1415926 *(i + o*1 + 0*  LFSR_Rand_Gen(pos)) / 64;
+
+		// push sample ray to stack for ray marching
+		RAY_STACK(0) = ray(pos, vec2(cos(angle), sin(angle)), vec3(1), RAY_DEPTH);
+		PROFILE_MAX(profile_max_depth, 1);
+		emissive += march();
+	}
+	return emissive / SAMPLE;
+}
@@ -2,7 +2,6 @@
 layout(location = 0) in vec3 position;
 layout (location = 1) in vec2 in_tex_coords;
 
-out vec4 gl_Position;
 out vec2 tex_coords;
 
 void main()
@@ -4,9 +4,49 @@ out vec4 FragColor;
   
 in vec2 tex_coords;
 
+#define EDGE_SHARPNESS 32
+
 uniform sampler2D screenTexture;
+uniform float exposure;
+// 1 for the full resolution accumulation, 2^n for a preview level
+uniform int preview_scale;
+
+// resolve radiance sum to the tone mapped mean of the accumulated iterations
+vec3 resolve(ivec2 p)
+{
+    vec4 accum = texelFetch(screenTexture, p, 0);
+    vec3 color = accum.a > 0 ? accum.rgb / accum.a : vec3(0);
+    // exponential tone mapping of the hdr result
+    return vec3(1) - exp(-color * exposure);
+}
+
+// upsample a preview stored in the bottom left of the texture, bilinear weights
+// are attenuated for texels unlike the nearest one to keep silhouettes sharp
+vec3 upsample(vec2 coord)
+{
+    ivec2 size = (textureSize(screenTexture, 0) + preview_scale - 1) / preview_scale;
+    vec2 p = coord / preview_scale - 0.5;
+    ivec2 base = ivec2(floor(p));
+    vec2 f = fract(p);
+    vec3 nearest = resolve(clamp(ivec2(round(p)), ivec2(0), size - 1));
+
+    vec3 sum = vec3(0);
+    float weight = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        ivec2 o = ivec2(i & 1, i >> 1);
+        vec3 c = resolve(clamp(base + o, ivec2(0), size - 1));
+        vec2 b = mix(1 - f, f, vec2(o));
+        vec3 d = c - nearest;
+        float w = b.x * b.y * exp(-dot(d, d) * EDGE_SHARPNESS) + 1e-5;
+        sum += c * w;
+        weight += w;
+    }
+    return sum / weight;
+}
 
 void main()
 { 
-    FragColor = texture(screenTexture, tex_coords);
+    vec3 color = preview_scale > 1 ? upsample(gl_FragCoord.xy) : resolve(ivec2(gl_FragCoord.xy));
+    FragColor = vec4(color, 1);
 }
\ No newline at end of file
@@ -0,0 +1,101 @@
+// signed distance functions of the scene primitives, included by march.glsl which ray.frag, ray.comp
+// and bench.comp share
+
+float circle_sdf(vec2 p, vec2 c, float r)
+{
+	return length(p - c) - r;
+}
+
+// axis aligned box centered at the origin with half size hs
+float box_sdf(vec2 v, vec2 hs)
+{
+	vec2 d = abs(v) - hs;
+	vec2 a = max(d, 0);
+
+	return min(max(d.x, d.y), 0) + length(a);
+}
+
+float rectangle_sdf(vec2 p, vec2 c, vec2 hs, float t)
+{
+	float cos_t = cos(t);
+	float sin_t = sin(t);
+	mat2 r = 
+	{
+		{ cos_t, -sin_t },
+		{ sin_t, cos_t }
+	};
+	
+	return box_sdf(r * (p - c), hs);
+}
+
+float cross(vec2 a, vec2 b)
+{
+	return a.x * b.y - a.y * b.x;
+}
+
+// o = winding order
+float segment_sdf(vec2 p, vec2 a, vec2 b, inout float o)
+{
+	vec2 v = p - a;
+	vec2 s = b - a;
+	float l = s.x * s.x + s.y * s.y;
+	float k = clamp(dot(v, s) / l, 0, 1);
+	o = min(o, sign(cross(v, s)));
+	return length(v - s * k);
+}
+
+float triangle_sdf(vec2 p, vec2 v[3])
+{
+	float o = 1;
+	float d = segment_sdf(p, v[0], v[1], o);
+	d = min(d, segment_sdf(p, v[1], v[2], o));
+	d = min(d, segment_sdf(p, v[2], v[0], o));
+	return o * -d;
+}
+
+float regular_triangle_sdf(vec2 p, vec2 c, float r, float t)
+{
+	float ia = TWO_PI / 3;
+	vec2[3] e =
+	{
+		vec2(cos(t), sin(t)),
+		vec2(cos(t - ia), sin(t - ia)),
+		vec2(cos(t + ia), sin(t + ia))
+	};
+	return triangle_sdf((p - c) / r, e) * r;
+}
+
+float pentagon_sdf(vec2 p, vec2 v[5])
+{
+	float o = 1;
+	float d = segment_sdf(p, v[0], v[1], o);
+	d = min(d, segment_sdf(p, v[1], v[2], o));
+	d = min(d, segment_sdf(p, v[2], v[3], o));
+	d = min(d, segment_sdf(p, v[3], v[4], o));
+	d = min(d, segment_sdf(p, v[4], v[0], o));
+	return o * -d;
+}
+
+float regular_pentagon_sdf(vec2 p, vec2 c, float r, float t)
+{
+	vec2 v = (p - c) / r;
+	float ia = TWO_PI / 5;
+	float ia2 = ia * 2;
+
+	vec2[5] e =
+	{
+		vec2(cos(t), sin(t)),
+		vec2(cos(t - ia), sin(t - ia)),
+		vec2(cos(t - ia2), sin(t - ia2)),
+		vec2(cos(t + ia2), sin(t + ia2)),
+		vec2(cos(t + ia), sin(t + ia))
+	};
+
+	float o = 1;
+	float d = segment_sdf(v, e[0], e[1], o);
+	d = min(d, segment_sdf(v, e[1], e[2], o));
+	d = min(d, segment_sdf(v, e[2], e[3], o));
+	d = min(d, segment_sdf(v, e[3], e[4], o));
+	d = min(d, segment_sdf(v, e[4], e[0], o));
+	return o * -d * r;
+}
@@ -0,0 +1,139 @@
+#include <string.h>
+#include <iostream>
+
+#include "AccumulationFile.h"
+
+using namespace std;
+
+#define ACCUMULATION_VERSION 2
+
+bool AccumulationFile::Open(const char *accum_file, int width, int height, int tile_size, float light_x, float light_y,
+	unsigned long long scene_hash)
+{
+	Close();
+	this->tile_size = tile_size;
+	tiles_x = (width + tile_size - 1) / tile_size;
+	tiles_y = (height + tile_size - 1) / tile_size;
+
+	size_t tile_count = (size_t)tiles_x * tiles_y;
+	size_t header_size = sizeof(Header) + tile_count * sizeof(unsigned int);
+	size_t data_offset = (header_size + ACCUMULATION_ALIGNMENT - 1) / ACCUMULATION_ALIGNMENT * ACCUMULATION_ALIGNMENT;
+	size_t size = data_offset + tile_count * TileBytes();
+
+	// new files are extended to full size, the tiles read as zero until rendered
+	if (!file.Create(accum_file, size))
+	{
+		cout << "failed to open accumulation " << accum_file << endl;
+		return false;
+	}
+	unsigned char *view = file.GetData();
+	bool created = file.IsNew();
+
+	header = (Header *)view;
+	tile_iterations = (unsigned int *)(view + sizeof(Header));
+	tiles = view + data_offset;
+
+	if (created)
+	{
+		memcpy(header->magic, "L2DA", 4);
+		header->version = ACCUMULATION_VERSION;
+		header->width = width;
+		header->height = height;
+		header->tile_size = tile_size;
+		header->light_x = light_x;
+		header->light_y = light_y;
+		header->scene_hash = scene_hash;
+		file.Flush(view, header_size);
+	}
+	else if (memcmp(header->magic, "L2DA", 4) != 0 || header->version != ACCUMULATION_VERSION)
+	{
+		Close();
+		cout << accum_file << " is not an accumulation file" << endl;
+		return false;
+	}
+	else if (header->width != width || header->height != height || header->tile_size != tile_size
+		|| header->light_x != light_x || header->light_y != light_y || header->scene_hash != scene_hash)
+	{
+		cout << accum_file << " was rendered with a different size, tile size, light or scene "
+			<< header->width << " x " << header->height << " tile " << header->tile_size
+			<< " light " << header->light_x << " " << header->light_y << endl;
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void AccumulationFile::Close()
+{
+	file.Close();
+	header = nullptr;
+	tile_iterations = nullptr;
+	tiles = nullptr;
+}
+
+unsigned int AccumulationFile::GetTileIteration(int tx, int ty) const
+{
+	return tile_iterations[ty * tiles_x + tx];
+}
+
+float *AccumulationFile::GetTile(int tx, int ty) const
+{
+	return (float *)(tiles + (size_t)(ty * tiles_x + tx) * TileBytes());
+}
+
+void AccumulationFile::CommitTile(int tx, int ty, unsigned int iteration)
+{
+	// the count is only recorded once the data is on disk, an interrupted
+	// commit resumes from the older count which at worst repeats some samples
+	file.Flush(GetTile(tx, ty), TileBytes());
+	tile_iterations[ty * tiles_x + tx] = iteration;
+	file.Flush(&tile_iterations[ty * tiles_x + tx], sizeof(unsigned int));
+}
+
+int AccumulationFile::Merge(const char *part_file)
+{
+	// a shard that never started leaves its tiles to be rendered here
+	MappedFile part;
+	if (!part.Open(part_file))
+	{
+		cout << part_file << " is missing, its tiles are rendered here" << endl;
+		return 0;
+	}
+	const Header *part_header = (const Header *)part.GetData();
+	if (part.GetSize() != file.GetSize() || memcmp(part_header->magic, header->magic, 4) != 0
+		|| part_header->version != header->version || part_header->width != header->width
+		|| part_header->height != header->height || part_header->tile_size != header->tile_size
+		|| part_header->light_x != header->light_x || part_header->light_y != header->light_y
+		|| part_header->scene_hash != header->scene_hash)
+	{
+		cout << part_file << " is an accumulation of a different image" << endl;
+		return -1;
+	}
+
+	// same layout, so tiles are at the same offsets in both files
+	const unsigned int *part_iterations = (const unsigned int *)(part.GetData() + sizeof(Header));
+	const unsigned char *part_tiles = part.GetData() + (tiles - file.GetData());
+	int merged = 0;
+	for (int ty = 0; ty < tiles_y; ty++)
+	{
+		for (int tx = 0; tx < tiles_x; tx++)
+		{
+			size_t index = (size_t)ty * tiles_x + tx;
+			if (part_iterations[index] <= tile_iterations[index])
+				continue;
+			memcpy(GetTile(tx, ty), part_tiles + index * TileBytes(), TileBytes());
+			CommitTile(tx, ty, part_iterations[index]);
+			merged++;
+		}
+		Release(ty);
+	}
+	return merged;
+}
+
+void AccumulationFile::Release(int ty)
+{
+	unsigned char *row = (unsigned char *)GetTile(0, ty);
+	size_t bytes = (size_t)tiles_x * TileBytes();
+	file.Flush(row, bytes);
+	file.Release(row, bytes);
+}
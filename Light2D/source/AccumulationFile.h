@@ -0,0 +1,61 @@
+#pragma once
+#include <stddef.h>
+#include "MappedFile.h"
+
+#define TILE_SIZE 1024 // default tile edge in pixels for out-of-core renders
+#define ACCUMULATION_ALIGNMENT 65536 // tile data starts on allocation granularity boundaries
+
+// memory mapped rgba float accumulation of an image too large to keep in ram,
+// stored as square tiles each contiguous in the file so a finished tile can be
+// written back and dropped from the working set, a per tile iteration count in
+// the header lets an interrupted render resume where it stopped
+class AccumulationFile
+{
+public:
+	AccumulationFile() { };
+	// remove copy constructor/assignment
+	AccumulationFile(const AccumulationFile &) = delete;
+	AccumulationFile &operator=(const AccumulationFile &) = delete;
+
+	// open an existing accumulation of the same image or create a new empty one,
+	// fails if the existing file was rendered with a different size, tiling, light or scene
+	bool Open(const char *accum_file, int width, int height, int tile_size, float light_x, float light_y,
+		unsigned long long scene_hash);
+	void Close();
+
+	int GetTilesX() const { return tiles_x; }
+	int GetTilesY() const { return tiles_y; }
+	int GetTileSize() const { return tile_size; }
+	// iterations stored for the tile, 0 if it was never rendered
+	unsigned int GetTileIteration(int tx, int ty) const;
+	// tile_size x tile_size rgba floats, rows ordered bottom to top,
+	// rgb holds the radiance sum and alpha the number of accumulated iterations
+	float *GetTile(int tx, int ty) const;
+	// write the tile data to disk, then record its iteration count
+	void CommitTile(int tx, int ty, unsigned int iteration);
+	// drop a row of tiles from the working set, its pages are read back from disk if touched again
+	void Release(int ty);
+	// take the tiles another accumulation of the same image rendered further, e.g. a shard rendered
+	// by another process, returns the number of tiles taken, 0 if the file does not exist
+	// and -1 if it is an accumulation of a different image
+	int Merge(const char *part_file);
+
+private:
+	struct Header
+	{
+		char magic[4];
+		unsigned int version;
+		int width, height;
+		int tile_size;
+		float light_x, light_y;
+		unsigned long long scene_hash;
+	};
+
+	MappedFile file;
+	Header *header = nullptr;
+	unsigned int *tile_iterations = nullptr;
+	unsigned char *tiles = nullptr;
+	int tiles_x = 0, tiles_y = 0, tile_size = 0;
+
+	size_t TileBytes() const { return (size_t)tile_size * tile_size * 4 * sizeof(float); }
+};
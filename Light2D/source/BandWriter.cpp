@@ -0,0 +1,113 @@
+#include <string.h>
+#include <iostream>
+
+#include "BandWriter.h"
+#include "ImageWriter.h"
+#include "Trace.h"
+#include "Platform.h"
+
+using namespace std;
+
+BandWriter::~BandWriter()
+{
+	if (worker.joinable())
+		Close();
+}
+
+bool BandWriter::Open(const char *image_file, int width, int height)
+{
+	this->width = width;
+	this->height = height;
+	success = true;
+	closing = false;
+
+	const char *extension = strrchr(image_file, '.');
+	if (extension != nullptr && _stricmp(extension, ".pfm") == 0)
+	{
+		format = Format::PFM;
+		fopen_s(&stream, image_file, "wb");
+		if (stream == nullptr)
+		{
+			cout << "failed to open image " << image_file << endl;
+			return false;
+		}
+		// negative scale marks little endian data, pfm rows are bottom to top like gl
+		fprintf(stream, "PF\n%d %d\n-1.0\n", width, height);
+	}
+	else if (extension != nullptr && _stricmp(extension, ".png") == 0)
+	{
+		format = Format::PNG;
+		if (!png.Open(image_file, width, height, 3, 8))
+			return false;
+	}
+	else
+	{
+		cout << "unsupported image format " << image_file << endl;
+		return false;
+	}
+
+	worker = thread(&BandWriter::Encode, this);
+	return true;
+}
+
+void BandWriter::Push(vector<float> &&rgb, int rows)
+{
+	unique_lock<mutex> lock(queue_mutex);
+	changed.wait(lock, [this]() { return bands.size() < MAX_BANDS_IN_FLIGHT; });
+	bands.push_back({ move(rgb), rows });
+	changed.notify_all();
+}
+
+bool BandWriter::Close()
+{
+	{
+		lock_guard<mutex> lock(queue_mutex);
+		closing = true;
+		changed.notify_all();
+	}
+	worker.join();
+
+	if (format == Format::PFM)
+	{
+		success = success && ferror(stream) == 0;
+		fclose(stream);
+		stream = nullptr;
+	}
+	else
+	{
+		success = png.Close() && success;
+	}
+	return success;
+}
+
+void BandWriter::Encode()
+{
+	Trace::SetThreadName("band writer");
+	vector<unsigned char> pixels;
+	while (true)
+	{
+		Band band;
+		{
+			unique_lock<mutex> lock(queue_mutex);
+			changed.wait(lock, [this]() { return !bands.empty() || closing; });
+			if (bands.empty())
+				return;
+			band = move(bands.front());
+			bands.pop_front();
+			changed.notify_all();
+		}
+
+		TRACE_SCOPE("encode");
+		if (format == Format::PFM)
+		{
+			size_t size = (size_t)width * band.rows * 3;
+			success = success && fwrite(band.rgb.data(), sizeof(float), size, stream) == size;
+		}
+		else
+		{
+			pixels.resize((size_t)width * band.rows * 3);
+			ImageWriter::ToneMap(band.rgb.data(), width, band.rows, exposure, pixels.data());
+			png.WriteRows(pixels.data(), band.rows);
+		}
+	}
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <stdio.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "PngWriter.h"
+
+#define MAX_BANDS_IN_FLIGHT 2 // bands queued for encoding before Push blocks
+
+// streams horizontal bands of rgb radiance into a png or pfm file on a worker thread,
+// encoding overlaps with rendering of the following bands and memory stays bounded by the band size
+class BandWriter
+{
+public:
+	// threads encode png bands, 0 uses all hardware threads
+	BandWriter(float exposure, unsigned int threads = 0) : exposure(exposure), png(threads) { };
+	// remove copy constructor/assignment
+	BandWriter(const BandWriter &) = delete;
+	BandWriter &operator=(const BandWriter &) = delete;
+	// closes the file if still open
+	~BandWriter();
+
+	bool Open(const char *image_file, int width, int height);
+	// png bands must be pushed from the top of the image down, pfm bands from the bottom up
+	bool IsTopDown() const { return format == Format::PNG; }
+	// queue the next band, rgb rows ordered bottom to top as read back from gl
+	void Push(std::vector<float> &&rgb, int rows);
+	// wait for all queued bands and finish the file
+	bool Close();
+
+private:
+	enum class Format { PNG, PFM };
+
+	struct Band
+	{
+		std::vector<float> rgb;
+		int rows;
+	};
+
+	float exposure;
+	Format format = Format::PNG;
+	int width = 0, height = 0;
+	FILE *stream = nullptr;
+	PngWriter png;
+	bool success = true;
+
+	std::thread worker;
+	std::mutex queue_mutex;
+	std::condition_variable changed;
+	std::deque<Band> bands;
+	bool closing = false;
+
+	void Encode();
+};
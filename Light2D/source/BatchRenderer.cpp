@@ -0,0 +1,629 @@
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <sstream>
+#include <string.h>
+
+#include "BatchRenderer.h"
+#include "BandWriter.h"
+#include "ImageWriter.h"
+#include "Heatmap.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include "Platform.h"
+
+using namespace std;
+using namespace std::chrono;
+
+bool BatchRenderer::ParseJob(int argc, const char *const argv[], RenderJob &job)
+{
+	for (int i = 0; i < argc; i++)
+	{
+		const char *option = argv[i];
+		bool has_value = i + 1 < argc;
+		if ((strcmp(option, "-o") == 0 || strcmp(option, "--output") == 0) && has_value)
+		{
+			job.output = argv[++i];
+		}
+		else if (strcmp(option, "--size") == 0 && has_value)
+		{
+			if (sscanf_s(argv[++i], "%dx%d", &job.width, &job.height) != 2 || job.width <= 0 || job.height <= 0)
+			{
+				cout << "invalid size " << argv[i] << endl;
+				return false;
+			}
+		}
+		else if (strcmp(option, "--iterations") == 0 && has_value)
+		{
+			job.iterations = min((unsigned int)atoi(argv[++i]), (unsigned int)ITERATION);
+		}
+		else if (strcmp(option, "--time") == 0 && has_value)
+		{
+			job.time_limit = atof(argv[++i]);
+		}
+		else if (strcmp(option, "--light") == 0 && i + 2 < argc)
+		{
+			job.light_x = (float)atof(argv[++i]);
+			job.light_y = (float)atof(argv[++i]);
+		}
+		else if (strcmp(option, "--exposure") == 0 && has_value)
+		{
+			job.exposure = (float)atof(argv[++i]);
+		}
+		else if (strcmp(option, "--scene") == 0 && has_value)
+		{
+			job.scene = argv[++i];
+		}
+		else if (strcmp(option, "--quality") == 0 && has_value)
+		{
+			if (!Renderer::ParseQuality(argv[++i], job.quality))
+			{
+				cout << "unknown quality " << argv[i] << endl;
+				return false;
+			}
+		}
+		else if (strcmp(option, "--threads") == 0 && has_value)
+		{
+			job.threads = (unsigned int)max(atoi(argv[++i]), 0);
+		}
+		else if (strcmp(option, "--compute") == 0)
+		{
+			job.compute = true;
+		}
+		else if (strcmp(option, "--heatmap") == 0 && has_value)
+		{
+			job.heatmap = argv[++i];
+		}
+		else if (strcmp(option, "--trace") == 0 && has_value)
+		{
+			job.trace = argv[++i];
+		}
+		else if (strcmp(option, "--compare") == 0 && has_value)
+		{
+			job.compare = argv[++i];
+		}
+		else if (strcmp(option, "--record") == 0)
+		{
+			job.record = true;
+		}
+		else if (strcmp(option, "--max-relmse") == 0 && has_value)
+		{
+			job.max_relmse = atof(argv[++i]);
+		}
+		else if (strcmp(option, "--budget") == 0 && has_value)
+		{
+			job.time_budget = atof(argv[++i]);
+		}
+		else if (strcmp(option, "--frames") == 0 && has_value)
+		{
+			job.frames = max(atoi(argv[++i]), 0);
+		}
+		else if (strcmp(option, "--key") == 0 && i + 3 < argc)
+		{
+			LightKey key;
+			key.frame = atoi(argv[++i]);
+			key.x = (float)atof(argv[++i]);
+			key.y = (float)atof(argv[++i]);
+			job.keys.push_back(key);
+		}
+		else if (strcmp(option, "--accum") == 0 && has_value)
+		{
+			job.accumulation = argv[++i];
+		}
+		else if (strcmp(option, "--tile") == 0 && has_value)
+		{
+			job.tile_size = atoi(argv[++i]);
+			if (job.tile_size <= 0)
+			{
+				cout << "invalid tile size " << argv[i] << endl;
+				return false;
+			}
+		}
+		else if (strcmp(option, "--tiles") == 0 && i + 2 < argc)
+		{
+			job.tile_first = atoi(argv[++i]);
+			job.tile_count = atoi(argv[++i]);
+			if (job.tile_first < 0 || job.tile_count <= 0)
+			{
+				cout << "invalid tile range " << argv[i - 1] << " " << argv[i] << endl;
+				return false;
+			}
+		}
+		else if (strcmp(option, "--merge") == 0 && has_value)
+		{
+			job.merge.push_back(argv[++i]);
+		}
+		else
+		{
+			cout << "unknown option " << option << endl;
+			return false;
+		}
+	}
+
+	if ((job.tile_count > 0 || !job.merge.empty()) && job.accumulation.empty())
+	{
+		cout << "tile ranges and merges need an accumulation file" << endl;
+		return false;
+	}
+	// a shard only renders into its accumulation
+	if (job.output.empty() && job.tile_count == 0)
+	{
+		cout << "missing output file" << endl;
+		return false;
+	}
+	if (job.frames > 0 && !job.accumulation.empty())
+	{
+		cout << "sequences can not be rendered out of core" << endl;
+		return false;
+	}
+	if (!job.heatmap.empty() && (job.frames > 0 || !job.accumulation.empty()))
+	{
+		cout << "heatmaps are only written for single images" << endl;
+		return false;
+	}
+	if (!job.compare.empty() && (job.frames > 0 || !job.accumulation.empty()))
+	{
+		cout << "golden images are only compared for single images" << endl;
+		return false;
+	}
+	if (job.record && job.compare.empty())
+	{
+		cout << "--record needs the golden image to write with --compare" << endl;
+		return false;
+	}
+	sort(job.keys.begin(), job.keys.end(), [](const LightKey &a, const LightKey &b) { return a.frame < b.frame; });
+	return true;
+}
+
+bool BatchRenderer::LoadManifest(const char *manifest_file, vector<RenderJob> &jobs)
+{
+	ifstream stream(manifest_file);
+	if (!stream)
+	{
+		cout << "failed to open manifest " << manifest_file << endl;
+		return false;
+	}
+
+	string line;
+	int line_number = 0;
+	while (getline(stream, line))
+	{
+		line_number++;
+		line = line.substr(0, line.find('#'));
+
+		vector<string> tokens;
+		istringstream words(line);
+		string word;
+		while (words >> word)
+		{
+			tokens.push_back(word);
+		}
+		if (tokens.empty())
+		{
+			continue;
+		}
+
+		vector<const char *> args;
+		for (const string &token : tokens)
+		{
+			args.push_back(token.c_str());
+		}
+		RenderJob job;
+		if (!ParseJob((int)args.size(), args.data(), job))
+		{
+			cout << "invalid job at " << manifest_file << ":" << line_number << endl;
+			return false;
+		}
+		jobs.push_back(job);
+	}
+	return true;
+}
+
+void BatchRenderer::PrintUsage()
+{
+	cout << "usage: Light2D [-o output.png|pfm] [--size WxH] [--iterations n] [--time seconds]" << endl
+		<< "               [--light x y] [--exposure e] [--scene file.scene] [--quality draft|default|high]" << endl
+		<< "               [--compute] [--heatmap prefix] [--trace trace.json] [--threads n]" << endl
+		<< "               [--compare golden.pfm [--max-relmse e] [--budget fraction] [--record]]" << endl
+		<< "               [--accum file.accum [--tile n] [--tiles first count] [--merge part.accum]...]" << endl
+		<< "               [--frames n [--key frame x y]...]" << endl
+		<< "       Light2D --manifest jobs.txt [--record]" << endl
+		<< "       Light2D --isa scalar|sse4.2|avx2|avx512 [any of the above]" << endl
+		<< "       Light2D --convert-noise noise_map.png noise_map.noise" << endl
+		<< "       Light2D --create-noise [noise_map.noise]" << endl
+		<< "       Light2D --check-noise [size]" << endl
+		<< "       Light2D --check-threads [any job option]" << endl
+		<< "       Light2D --check-shards" << endl
+		<< "       Light2D --bench results.json [--size WxH]... [--scene file.scene]... [--quality q] [--passes n]" << endl
+		<< "                              [--reference converged.pfm] [--counters]" << endl
+		<< "--accum renders out of core through a memory mapped file, with --time it stops" << endl
+		<< "when the time is up and running the same job again resumes it, --tiles renders only a range" << endl
+		<< "of tiles in row order into the accumulation as one shard of a render split across processes," << endl
+		<< "--merge takes the finished tiles of shards and renders the tiles of missing ones before resolving," << endl
+		<< "--check-shards renders shards in separate processes and compares their merge with one process" << endl
+		<< "--frames renders a sequence to output_0000.png..., the light moves between the keyed" << endl
+		<< "positions and --time limits each frame" << endl
+		<< "--compute accumulates with a compute shader that stops rendering tiles once they converge" << endl
+		<< "--heatmap renders with per pixel cost counters and writes them as prefix_steps.png," << endl
+		<< "prefix_scene_calls.png, prefix_max_depth.png, prefix_pushes.png, prefix_exhausted.png" << endl
+		<< "and prefix_histogram.csv" << endl
+		<< "--trace writes the cpu and gpu phases of the job as chrome trace json" << endl
+		<< "--threads sets the png encoder threads, --check-threads renders a job, by default the sample scene" << endl
+		<< "at 640x360, with 1, 7 and 64 of them and fails unless the files hash the same" << endl
+		<< "--compare fails the job when the radiance differs from the golden pfm by more than the relmse" << endl
+		<< "or it renders slower than the golden timing beyond the budget or the golden files are missing," << endl
+		<< "--record writes the render and its timing as the golden files instead, both need the noise" << endl
+		<< "map written by --create-noise" << endl
+		<< "--bench times the shader functions, march() and accumulation passes of each scene and size" << endl
+		<< "on both render paths and writes the results as json, --reference adds the error and efficiency" << endl
+		<< "over time of every path and quality against a pfm of the first scene to results_convergence.csv," << endl
+		<< "--counters adds the ipc and cache and branch miss rates of every stage from cpu hardware counters" << endl
+		<< "--isa forces the cpu kernels to an older instruction set than the one detected" << endl
+		<< "without arguments Light2D runs interactively, C toggles the compute shader, T starts tracing" << endl
+		<< "and the next T writes " << TRACE_FILE << endl;
+}
+
+bool BatchRenderer::Run(const RenderJob &job)
+{
+	if (!renderer.SetScene(job.scene.c_str(), job.quality) || !renderer.IsValid() || !renderer.SetComputePath(job.compute)
+		|| !renderer.SetProfiling(!job.heatmap.empty()))
+		return false;
+	// golden images are rendered with the generated noise, constant offsets would fail every comparison
+	if (!job.compare.empty() && !renderer.HasNoise())
+	{
+		cout << "missing " << NOISE_ASSET << " for " << job.compare << ", create it with Light2D --create-noise" << endl;
+		return false;
+	}
+	if (!job.accumulation.empty())
+		return RunTiled(job);
+	if (job.frames > 0)
+		return RunSequence(job);
+
+	auto start = high_resolution_clock::now();
+	auto elapsed = [&]() { return duration_cast<duration<double>>(high_resolution_clock::now() - start).count(); };
+
+	BandWriter writer(job.exposure, job.threads);
+	if (!writer.Open(job.output.c_str(), job.width, job.height))
+		return false;
+
+	if (renderer.GetWidth() != job.width || renderer.GetHeight() != job.height)
+	{
+		renderer.Resize(job.width, job.height);
+	}
+	renderer.SetTile(0, 0, job.width, job.height);
+	renderer.Clear();
+	renderer.SetLight(job.light_x < 0 ? job.width * 0.5f : job.light_x, job.light_y < 0 ? job.height * 0.5f : job.light_y);
+
+	// render band by band in file order, each finished band is encoded while the next one renders
+	int bands = (job.height + BAND_ROWS - 1) / BAND_ROWS;
+	unsigned int passes = 0;
+	// the whole radiance is only kept for the golden comparison
+	vector<float> image(job.compare.empty() ? 0 : (size_t)job.width * job.height * 3);
+	for (int b = 0; b < bands; b++)
+	{
+		// gl rows start at the bottom
+		int index = writer.IsTopDown() ? bands - 1 - b : b;
+		int y = index * BAND_ROWS;
+		int rows = min(BAND_ROWS, job.height - y);
+		// spread the remaining time evenly over the remaining bands
+		double band_limit = elapsed() + (job.time_limit - elapsed()) / (bands - b);
+		TRACE_SCOPE("band");
+
+		renderer.BeginBand(y, rows);
+		while (renderer.GetIteration() < job.iterations)
+		{
+			renderer.RenderPass(0);
+			passes++;
+			if (job.time_limit > 0)
+			{
+				// wait for the pass so the time limit is measured against finished work
+				glFinish();
+				if (elapsed() > band_limit)
+					break;
+			}
+		}
+
+		vector<float> rgb((size_t)job.width * rows * 3);
+		renderer.ReadRadiance(rgb.data(), y, rows);
+		if (!image.empty())
+			copy(rgb.begin(), rgb.end(), image.begin() + (size_t)y * job.width * 3);
+		writer.Push(move(rgb), rows);
+	}
+	double seconds = elapsed();
+	bool success = writer.Close();
+	if (!job.compare.empty())
+	{
+		double rays = (double)job.width * job.height * passes / bands * renderer.GetSamples();
+		success = CheckRegression(job, image, seconds, rays) && success;
+	}
+	if (!job.heatmap.empty())
+	{
+		vector<unsigned int> counters((size_t)job.width * job.height * PROFILE_COUNTERS);
+		renderer.ReadProfile(counters.data());
+		success = Heatmap::Write(job.heatmap.c_str(), job.width, job.height, counters.data()) && success;
+	}
+
+	cout << job.output << " " << job.width << " x " << job.height << " " << passes / (float)bands
+		<< " iterations " << elapsed() << " s" << (success ? "" : " FAILED") << endl;
+	return success;
+}
+
+bool BatchRenderer::RunTiled(const RenderJob &job)
+{
+	auto start = high_resolution_clock::now();
+	auto elapsed = [&]() { return duration_cast<duration<double>>(high_resolution_clock::now() - start).count(); };
+
+	float light_x = job.light_x < 0 ? job.width * 0.5f : job.light_x;
+	float light_y = job.light_y < 0 ? job.height * 0.5f : job.light_y;
+	AccumulationFile accum;
+	if (!accum.Open(job.accumulation.c_str(), job.width, job.height, job.tile_size, light_x, light_y, renderer.GetSceneHash()))
+		return false;
+	for (const string &part : job.merge)
+	{
+		int merged = accum.Merge(part.c_str());
+		if (merged < 0)
+			return false;
+		cout << "merged " << merged << " tiles from " << part << endl;
+	}
+
+	// a shard renders its range of tiles and leaves resolving to the job merging it
+	bool shard = job.tile_count > 0;
+	BandWriter writer(job.exposure, job.threads);
+	if (!shard && !writer.Open(job.output.c_str(), job.width, job.height))
+		return false;
+
+	int tile = accum.GetTileSize();
+	if (renderer.GetWidth() != tile || renderer.GetHeight() != tile)
+	{
+		renderer.Resize(tile, tile);
+	}
+	renderer.SetLight(light_x, light_y);
+
+	// walk tile rows in file order so each row is resolved to the output as soon as it is done,
+	// only the current row of tiles is resident and finished rows are dropped from memory
+	int tiles_x = accum.GetTilesX(), tiles_y = accum.GetTilesY();
+	int rendered = 0;
+	bool paused = false;
+	for (int r = 0; r < tiles_y && !paused; r++)
+	{
+		int ty = !shard && writer.IsTopDown() ? tiles_y - 1 - r : r;
+		for (int tx = 0; tx < tiles_x && !paused; tx++)
+		{
+			int index = ty * tiles_x + tx;
+			if (shard && (index < job.tile_first || index >= job.tile_first + job.tile_count))
+				continue;
+			unsigned int iteration = accum.GetTileIteration(tx, ty);
+			if (iteration >= job.iterations)
+				continue;
+
+			TRACE_SCOPE("tile");
+			float *data = accum.GetTile(tx, ty);
+			renderer.SetTile(tx * tile, ty * tile, job.width, job.height);
+			renderer.Clear();
+			if (iteration > 0)
+			{
+				renderer.LoadAccumulation(data, iteration);
+			}
+			while (renderer.GetIteration() < job.iterations)
+			{
+				renderer.RenderPass(0);
+				if (job.time_limit > 0)
+				{
+					glFinish();
+					if (elapsed() > job.time_limit)
+					{
+						paused = true;
+						break;
+					}
+				}
+			}
+			renderer.ReadAccumulation(data);
+			accum.CommitTile(tx, ty, renderer.GetIteration());
+			rendered++;
+		}
+		if (paused)
+			break;
+		if (shard)
+		{
+			accum.Release(ty);
+			continue;
+		}
+
+		// resolve the row of tiles to the output in bands
+		int y0 = ty * tile;
+		int tile_rows = min(tile, job.height - y0);
+		int bands = (tile_rows + BAND_ROWS - 1) / BAND_ROWS;
+		for (int b = 0; b < bands; b++)
+		{
+			int index = writer.IsTopDown() ? bands - 1 - b : b;
+			int y = index * BAND_ROWS;
+			int rows = min(BAND_ROWS, tile_rows - y);
+			TRACE_SCOPE("resolve");
+
+			vector<float> rgb((size_t)job.width * rows * 3);
+			for (int tx = 0; tx < tiles_x; tx++)
+			{
+				const float *data = accum.GetTile(tx, ty);
+				int columns = min(tile, job.width - tx * tile);
+				for (int row = 0; row < rows; row++)
+				{
+					const float *src = data + ((size_t)(y + row) * tile) * 4;
+					float *dst = rgb.data() + ((size_t)row * job.width + tx * tile) * 3;
+					for (int x = 0; x < columns; x++)
+					{
+						float n = src[x * 4 + 3];
+						for (int c = 0; c < 3; c++)
+						{
+							dst[x * 3 + c] = n > 0 ? src[x * 4 + c] / n : 0;
+						}
+					}
+				}
+			}
+			writer.Push(move(rgb), rows);
+		}
+		accum.Release(ty);
+	}
+
+	if (shard)
+	{
+		cout << job.accumulation << " tiles " << job.tile_first << " to " << job.tile_first + job.tile_count - 1
+			<< " (" << rendered << " rendered) " << elapsed() << " s" << (paused ? ", run the job again to resume" : "") << endl;
+		return true;
+	}
+	if (paused)
+	{
+		// the partial output is discarded, the accumulation holds all finished work
+		writer.Close();
+		remove(job.output.c_str());
+		cout << job.accumulation << " paused after " << rendered << " tiles " << elapsed()
+			<< " s, run the job again to resume" << endl;
+		return true;
+	}
+	bool success = writer.Close();
+
+	cout << job.output << " " << job.width << " x " << job.height << " " << tiles_x * tiles_y << " tiles ("
+		<< rendered << " rendered) " << elapsed() << " s" << (success ? "" : " FAILED") << endl;
+	return success;
+}
+
+bool BatchRenderer::RunSequence(const RenderJob &job)
+{
+	auto start = high_resolution_clock::now();
+	auto elapsed = [&]() { return duration_cast<duration<double>>(high_resolution_clock::now() - start).count(); };
+
+	if (renderer.GetWidth() != job.width || renderer.GetHeight() != job.height)
+	{
+		renderer.Resize(job.width, job.height);
+	}
+	renderer.SetTile(0, 0, job.width, job.height);
+
+	// frame n is encoded on a worker while frame n + 1 renders, one frame in flight bounds memory
+	size_t extension = job.output.find_last_of('.');
+	future<bool> encoding;
+	vector<float> rgb((size_t)job.width * job.height * 3);
+	float last_x = -1, last_y = -1;
+	int failed = 0, reused = 0;
+	for (int frame = 0; frame < job.frames; frame++)
+	{
+		float x, y;
+		GetLight(job, frame, x, y);
+		// frames holding the light still reuse the previous radiance instead of rendering again
+		bool reuse = frame > 0 && x == last_x && y == last_y;
+		TRACE_SCOPE("frame");
+		if (!reuse)
+		{
+			double frame_start = elapsed();
+			renderer.Clear();
+			renderer.SetLight(x, y);
+			while (renderer.GetIteration() < job.iterations)
+			{
+				renderer.RenderPass(0);
+				if (job.time_limit > 0)
+				{
+					glFinish();
+					if (elapsed() - frame_start > job.time_limit)
+						break;
+				}
+			}
+		}
+		else
+		{
+			reused++;
+		}
+
+		// the previous frame must be written before its buffer is replaced
+		if (encoding.valid() && !encoding.get())
+			failed++;
+		if (!reuse)
+		{
+			renderer.ReadRadiance(rgb.data(), 0, job.height);
+		}
+		last_x = x;
+		last_y = y;
+
+		char number[16];
+		snprintf(number, sizeof(number), "_%04d", frame);
+		string file = job.output;
+		file.insert(extension == string::npos ? file.size() : extension, number);
+		encoding = async(launch::async, [file, &rgb, &job]()
+		{
+			Trace::SetThreadName("frame encoder");
+			TRACE_SCOPE("encode");
+			return ImageWriter::Write(file.c_str(), job.width, job.height, rgb.data(), job.exposure, job.threads);
+		});
+	}
+	if (encoding.valid() && !encoding.get())
+		failed++;
+
+	double seconds = elapsed();
+	cout << job.output << " " << job.frames << " frames (" << reused << " reused) " << job.width << " x " << job.height
+		<< " " << seconds << " s " << job.frames * 60. / seconds << " frames per minute"
+		<< (failed > 0 ? " FAILED" : "") << endl;
+	return failed == 0;
+}
+
+bool BatchRenderer::CheckRegression(const RenderJob &job, const vector<float> &rgb, double seconds, double rays)
+{
+	string timing_file = job.compare + ".timing";
+	if (job.record)
+	{
+		ofstream golden_timing(timing_file);
+		golden_timing << seconds << " " << rays / seconds << endl;
+		bool success = ImageWriter::WritePFM(job.compare.c_str(), job.width, job.height, rgb.data()) && !!golden_timing;
+		cout << job.compare << (success ? " recorded as golden image" : " could not be recorded") << endl;
+		return success;
+	}
+
+	// a missing golden file fails like a regression, so a typo or a lost reference is not accepted silently
+	int width, height;
+	vector<float> reference;
+	ifstream timing(timing_file);
+	double golden_seconds = 0, golden_rays = 0;
+	if (!Metrics::LoadPFM(job.compare.c_str(), width, height, reference) || !(timing >> golden_seconds >> golden_rays))
+	{
+		cout << "missing golden image or timing " << job.compare << ", run the job with --record to create them" << endl;
+		return false;
+	}
+	if (width != job.width || height != job.height)
+	{
+		cout << job.compare << " is " << width << " x " << height << ", the job renders " << job.width << " x " << job.height << endl;
+		return false;
+	}
+
+	ImageError error = Metrics::Compare(rgb.data(), reference.data(), (size_t)width * height, job.exposure);
+	bool image_passed = error.relmse <= job.max_relmse;
+	bool time_passed = seconds <= golden_seconds * (1 + job.time_budget)
+		&& rays / seconds >= golden_rays * (1 - job.time_budget);
+	cout << job.compare << " relmse " << error.relmse << " (max " << job.max_relmse << ") rmse " << error.rmse
+		<< " " << seconds << " s (golden " << golden_seconds << " s) " << rays / seconds << " rays/s (golden "
+		<< golden_rays << ")" << (image_passed ? "" : " IMAGE REGRESSION") << (time_passed ? "" : " TIME REGRESSION") << endl;
+	return image_passed && time_passed;
+}
+
+void BatchRenderer::GetLight(const RenderJob &job, int frame, float &x, float &y)
+{
+	x = job.light_x < 0 ? job.width * 0.5f : job.light_x;
+	y = job.light_y < 0 ? job.height * 0.5f : job.light_y;
+	if (job.keys.empty())
+		return;
+
+	// hold the first and last key outside the keyed range
+	const LightKey *next = &job.keys.back();
+	const LightKey *previous = &job.keys.front();
+	for (const LightKey &key : job.keys)
+	{
+		if (key.frame <= frame)
+			previous = &key;
+		if (key.frame >= frame)
+		{
+			next = &key;
+			break;
+		}
+	}
+	float t = next->frame > previous->frame ? (frame - previous->frame) / (float)(next->frame - previous->frame) : 0;
+	t = min(max(t, 0.f), 1.f);
+	x = previous->x + (next->x - previous->x) * t;
+	y = previous->y + (next->y - previous->y) * t;
+}
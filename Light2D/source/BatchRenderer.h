@@ -0,0 +1,83 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "Renderer.h"
+#include "AccumulationFile.h"
+
+#define BAND_ROWS 128 // rows rendered and streamed to the output at a time
+#define MAX_RELMSE 0.001 // default error allowed against a golden image
+#define TIME_BUDGET 0.2 // default slowdown allowed against the golden timing, as a fraction
+
+// light position at a frame of a sequence, frames in between are interpolated linearly
+struct LightKey
+{
+	int frame;
+	float x, y;
+};
+
+struct RenderJob
+{
+	int width = 1920;
+	int height = 1080;
+	unsigned int iterations = ITERATION;
+	double time_limit = 0; // seconds, 0 renders all iterations
+	float light_x = -1, light_y = -1; // pixels from the bottom left, negative centers the light
+	float exposure = 1;
+	std::string scene = DEFAULT_SCENE;
+	Quality quality = Quality::Default;
+	// accumulate with the compute shader, skipping tiles that stopped changing
+	bool compute = false;
+	// write per pixel cost heatmaps and histograms with this prefix, see Heatmap
+	std::string heatmap;
+	// write a chrome trace of the job to this file, see Trace
+	std::string trace;
+	// golden pfm the render must match within max_relmse, the job also fails when it is slower
+	// than the recorded timing by more than time_budget or the golden files are missing
+	std::string compare;
+	double max_relmse = MAX_RELMSE;
+	double time_budget = TIME_BUDGET;
+	// write the render and its timing as the golden files instead of comparing against them
+	bool record = false;
+	std::string output;
+	// threads encoding png output, 0 uses all hardware threads, the file does not depend on it
+	unsigned int threads = 0;
+	// out-of-core render through a memory mapped accumulation file, rerunning resumes it
+	std::string accumulation;
+	int tile_size = TILE_SIZE;
+	// shard of an out-of-core render, only tiles [tile_first, tile_first + tile_count) in row order
+	// are rendered into the accumulation and nothing is written to the output, 0 renders all tiles
+	int tile_first = 0, tile_count = 0;
+	// accumulations of shards merged into the job's accumulation before its remaining tiles render
+	std::vector<std::string> merge;
+	// number of frames of an animated sequence, 0 renders a single image,
+	// each frame is written to the output name with the frame number appended
+	int frames = 0;
+	std::vector<LightKey> keys;
+};
+
+// renders jobs offscreen and writes the results to image files,
+// all jobs share one context and renderer so only the first one pays for start-up
+class BatchRenderer
+{
+public:
+	BatchRenderer(Renderer &renderer) : renderer(renderer) { };
+
+	// parse job options given in command line form, returns false on error
+	static bool ParseJob(int argc, const char *const argv[], RenderJob &job);
+	// manifest lists one job per line using the command line options, # starts a comment
+	static bool LoadManifest(const char *manifest_file, std::vector<RenderJob> &jobs);
+	static void PrintUsage();
+
+	bool Run(const RenderJob &job);
+
+private:
+	Renderer &renderer;
+
+	// render tile by tile into the accumulation file, then resolve it to the output
+	bool RunTiled(const RenderJob &job);
+	// render the frames of a sequence, each frame is encoded while the next one renders
+	bool RunSequence(const RenderJob &job);
+	static void GetLight(const RenderJob &job, int frame, float &x, float &y);
+	// compare a finished render against the job's golden image and timing, or record them
+	static bool CheckRegression(const RenderJob &job, const std::vector<float> &rgb, double seconds, double rays);
+};
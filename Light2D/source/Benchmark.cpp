@@ -0,0 +1,482 @@
+#include <string.h>
+#include <time.h>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+#include "Benchmark.h"
+#include "ImageWriter.h"
+#include "CpuFeatures.h"
+#include "Platform.h"
+
+using namespace std;
+using namespace std::chrono;
+
+struct BenchKernel
+{
+	const char *name;
+	// glsl expression of p and i returning a vec4
+	const char *expression;
+	// evaluations per invocation
+	int loop;
+};
+
+// the shapes sit around (1, 0.5), the middle of the benchmark area
+static const BenchKernel bench_kernels[] = {
+	{ "circle_sdf", "vec4(circle_sdf(p, vec2(1.0, 0.5), 0.1))", 256 },
+	{ "box_sdf", "vec4(box_sdf(p - vec2(1.0, 0.5), vec2(0.1, 0.05)))", 256 },
+	{ "rectangle_sdf", "vec4(rectangle_sdf(p, vec2(1.0, 0.5), vec2(0.1, 0.05), i))", 256 },
+	{ "triangle_sdf", "vec4(triangle_sdf(p, vec2[3](vec2(1.1, 0.5), vec2(0.95, 0.413397), vec2(0.95, 0.586603))))", 256 },
+	{ "pentagon_sdf", "vec4(pentagon_sdf(p, vec2[5](vec2(1.1, 0.5), vec2(1.030902, 0.404894), "
+		"vec2(0.919098, 0.441221), vec2(0.919098, 0.558779), vec2(1.030902, 0.595106))))", 256 },
+	{ "union_op", "vec4(union_op(result(p.x, vec3(i), vec3(0), vec3(0), vec3(0)), "
+		"result(p.y, vec3(0), vec3(i), vec3(0), vec3(0))).emissive, 0)", 256 },
+	{ "fresnelSchlick", "vec4(fresnelSchlick(p.x * 0.1, p.y))", 256 },
+	{ "beerLambert", "vec4(beerLambert(vec3(1, 2, 6), p.x), 0)", 256 },
+	{ "scene", "vec4(scene(p.x, p.y).signed_dist)", 64 },
+	{ "scene_distance", "vec4(scene_distance(p.x, p.y))", 64 },
+	{ "normal", "vec4(normal(p.x, p.y), 0, 0)", 16 },
+	{ "march", "vec4(march_ray(p, i * 0.7), 0)", 4 },
+};
+
+bool Benchmark::ParseOptions(int argc, const char *const argv[], BenchOptions &options)
+{
+	for (int i = 0; i < argc; i++)
+	{
+		const char *option = argv[i];
+		bool has_value = i + 1 < argc;
+		if (i == 0 && option[0] != '-')
+		{
+			options.output = option;
+		}
+		else if (strcmp(option, "--size") == 0 && has_value)
+		{
+			int width, height;
+			if (sscanf_s(argv[++i], "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0)
+			{
+				cout << "invalid size " << argv[i] << endl;
+				return false;
+			}
+			options.sizes.push_back({ width, height });
+		}
+		else if (strcmp(option, "--scene") == 0 && has_value)
+		{
+			options.scenes.push_back(argv[++i]);
+		}
+		else if (strcmp(option, "--quality") == 0 && has_value)
+		{
+			if (!Renderer::ParseQuality(argv[++i], options.quality))
+			{
+				cout << "unknown quality " << argv[i] << endl;
+				return false;
+			}
+		}
+		else if (strcmp(option, "--reference") == 0 && has_value)
+		{
+			options.reference = argv[++i];
+		}
+		else if (strcmp(option, "--counters") == 0)
+		{
+			options.counters = true;
+		}
+		else if (strcmp(option, "--passes") == 0 && has_value)
+		{
+			options.passes = atoi(argv[++i]);
+			if (options.passes <= 0 || options.passes >= MIN_TILE_ITERATION)
+			{
+				cout << "passes must be between 1 and " << MIN_TILE_ITERATION - 1 << endl;
+				return false;
+			}
+		}
+		else
+		{
+			cout << "unknown option " << option << endl;
+			return false;
+		}
+	}
+
+	if (options.output.empty())
+	{
+		cout << "missing output file" << endl;
+		return false;
+	}
+	if (options.sizes.empty())
+		options.sizes = { { 960, 540 }, { 1920, 1080 }, { 3840, 2160 } };
+	if (options.scenes.empty())
+		options.scenes = { DEFAULT_SCENE, "scene/empty.scene", "scene/dense.scene" };
+	return true;
+}
+
+bool Benchmark::Run()
+{
+	if (options.counters)
+		counters.reset(new PerfCounters());
+
+	bool success = true;
+	CountPhase("kernels", [&]() { success = RunKernels(); });
+	if (!success)
+		return false;
+	CountPhase("frames", [&]() { success = RunFrames(); });
+	if (!success)
+		return false;
+	if (!options.reference.empty())
+		CountPhase("convergence", [&]() { success = RunConvergence(); });
+	if (!success || !RunEncode())
+		return false;
+	return WriteJSON() && (options.reference.empty() || WriteCSV());
+}
+
+bool Benchmark::RunKernels()
+{
+	Scene scene;
+	if (!scene.Load(options.scenes[0].c_str()))
+		return false;
+	ShaderOptions ray_options = Renderer::GetRayOptions(scene, options.quality);
+
+	// results are written to a sink so the kernels are not optimised away
+	unsigned int sink;
+	glGenBuffers(1, &sink);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, sink);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, (size_t)BENCH_MAX_GROUPS * BENCH_GROUP_SIZE * sizeof(float), nullptr, GL_DYNAMIC_COPY);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, sink);
+
+	bool success = true;
+	for (const BenchKernel &kernel : bench_kernels)
+	{
+		ShaderOptions kernel_options = ray_options;
+		kernel_options.defines.push_back({ "BENCH_LOOP", to_string(kernel.loop) });
+		kernel_options.includes["kernel.glsl"] = string("vec4 bench_kernel(vec2 p, float i)\n{\n\treturn ")
+			+ kernel.expression + ";\n}\n";
+		Shader shader("shader/bench.comp", kernel_options);
+		if (!shader.IsLinked())
+		{
+			success = false;
+			break;
+		}
+
+		// the light is placed like in a batch render of a 16:9 frame
+		shader.Use();
+		glUniform2f(shader.GetUniform("viewport_size"), 1, 1);
+		glUniform2f(shader.GetUniform("light1.position"), 0.89f, 0.5f);
+
+		KernelResult result = { kernel.name, TimeKernel(shader, kernel.loop) };
+		cout << result.name << " " << result.evaluations_per_second << " evaluations/s" << endl;
+		kernel_results.push_back(result);
+	}
+	glDeleteBuffers(1, &sink);
+	return success;
+}
+
+double Benchmark::TimeKernel(Shader &shader, int loop)
+{
+	shader.Use();
+	// drivers may compile the program on its first dispatch
+	TimeGL([]() { glDispatchCompute(1, 1, 1); });
+
+	double rate = 0;
+	// double the dispatch until it is long enough to time, small ones only measure overhead
+	for (int groups = 1; groups <= BENCH_MAX_GROUPS; groups *= 2)
+	{
+		double seconds = TimeGL([&]() { glDispatchCompute(groups, 1, 1); });
+		rate = seconds > 0 ? (double)groups * BENCH_GROUP_SIZE * loop / seconds : 0;
+		if (seconds >= BENCH_MIN_TIME)
+			break;
+	}
+	return rate;
+}
+
+bool Benchmark::RunFrames()
+{
+	Renderer renderer(options.sizes[0].first, options.sizes[0].second, options.scenes[0].c_str(), options.quality);
+	for (const string &scene : options.scenes)
+	{
+		if (!renderer.SetScene(scene.c_str(), options.quality) || !renderer.IsValid())
+			return false;
+		for (const auto &size : options.sizes)
+		{
+			for (int compute = 0; compute < 2; compute++)
+			{
+				if (!renderer.SetComputePath(compute != 0))
+					continue;
+				renderer.Resize(size.first, size.second);
+				renderer.Clear();
+				renderer.SetLight(size.first * 0.5f, size.second * 0.5f);
+				// the first pass pays for lazy allocations and shader warm up
+				renderer.RenderPass(0);
+
+				double seconds = TimeGL([&]()
+				{
+					for (int i = 0; i < options.passes; i++)
+					{
+						renderer.RenderPass(0);
+					}
+				}) / options.passes;
+				double rays = (double)size.first * size.second * renderer.GetSamples();
+				FrameResult result = { scene, size.first, size.second, compute != 0, seconds * 1e3, seconds > 0 ? rays / seconds : 0 };
+				cout << scene << " " << size.first << " x " << size.second << (compute ? " compute " : " fragment ")
+					<< result.pass_ms << " ms/pass" << endl;
+				frame_results.push_back(result);
+			}
+		}
+	}
+	return true;
+}
+
+bool Benchmark::RunConvergence()
+{
+	int width, height;
+	vector<float> reference;
+	if (!Metrics::LoadPFM(options.reference.c_str(), width, height, reference))
+		return false;
+
+	Renderer renderer(width, height, options.scenes[0].c_str(), options.quality);
+	if (!renderer.IsValid())
+		return false;
+	vector<float> rgb(reference.size());
+	for (Quality quality : { Quality::Draft, Quality::Default, Quality::High })
+	{
+		for (int compute = 0; compute < 2; compute++)
+		{
+			if (!renderer.SetScene(options.scenes[0].c_str(), quality) || !renderer.SetComputePath(compute != 0))
+				continue;
+			renderer.Resize(width, height);
+			renderer.SetLight(width * 0.5f, height * 0.5f);
+			// warm up outside the timed passes
+			renderer.RenderPass(0);
+			renderer.Clear();
+
+			double seconds = 0;
+			for (int pass = 1; pass <= ITERATION; pass++)
+			{
+				seconds += TimeGL([&]() { renderer.RenderPass(0); });
+				// measure at doubling sample counts, the readback is not timed
+				if ((pass & (pass - 1)) != 0 && pass != ITERATION)
+					continue;
+				renderer.ReadRadiance(rgb.data(), 0, height);
+				ImageError error = Metrics::Compare(rgb.data(), reference.data(), (size_t)width * height);
+				ConvergenceResult result = { compute != 0, quality, pass, pass * renderer.GetSamples(), seconds,
+					error, Metrics::Efficiency(error, seconds) };
+				convergence_results.push_back(result);
+			}
+			const ConvergenceResult &last = convergence_results.back();
+			cout << Renderer::GetQualityName(quality) << (compute ? " compute " : " fragment ") << last.samples
+				<< " spp " << last.seconds << " s relmse " << last.error.relmse << " efficiency " << last.efficiency << endl;
+		}
+	}
+	return true;
+}
+
+bool Benchmark::RunEncode()
+{
+	int width = options.sizes[0].first, height = options.sizes[0].second;
+	Renderer renderer(width, height, options.scenes[0].c_str(), options.quality);
+	if (!renderer.IsValid())
+		return false;
+	renderer.Clear();
+	renderer.SetLight(width * 0.5f, height * 0.5f);
+	for (int i = 0; i < options.passes; i++)
+	{
+		renderer.RenderPass(0);
+	}
+	vector<float> rgb((size_t)width * height * 3);
+	renderer.ReadRadiance(rgb.data(), 0, height);
+
+	string file = options.output.substr(0, options.output.find_last_of('.')) + "_encode.png";
+	bool success = true;
+	encode_seconds = CountPhase("encode", [&]() { success = ImageWriter::WritePNG(file.c_str(), width, height, rgb.data(), 1); });
+	remove(file.c_str());
+	if (!success)
+		return false;
+	cout << "encode " << width << " x " << height << " " << encode_seconds * 1e3 << " ms" << endl;
+	return true;
+}
+
+double Benchmark::CountPhase(const char *phase, const function<void()> &stage)
+{
+	PerfSample start = counters ? counters->Read() : PerfSample();
+	auto begin = high_resolution_clock::now();
+	stage();
+	double seconds = duration<double>(high_resolution_clock::now() - begin).count();
+	if (!counters || !counters->IsAvailable())
+		return seconds;
+
+	PhaseResult result = { phase, seconds, counters->Read() - start };
+	const PerfSample &c = result.counters;
+	cout << phase << " ipc " << Ratio(c.Get(PerfCounter::Instructions), c.Get(PerfCounter::Cycles))
+		<< " cache miss rate " << Ratio(c.Get(PerfCounter::CacheMisses), c.Get(PerfCounter::CacheReferences))
+		<< " branch miss rate " << Ratio(c.Get(PerfCounter::BranchMisses), c.Get(PerfCounter::Branches)) << endl;
+	phase_results.push_back(result);
+	return seconds;
+}
+
+double Benchmark::TimeGL(const function<void()> &commands)
+{
+	// timer queries do not cover compute dispatches on every driver, the wall clock between
+	// two glFinish does
+	glFinish();
+	auto start = high_resolution_clock::now();
+	commands();
+	glFinish();
+	return duration<double>(high_resolution_clock::now() - start).count();
+}
+
+bool Benchmark::WriteJSON() const
+{
+	ofstream stream(options.output);
+	if (!stream)
+	{
+		cout << "failed to open " << options.output << endl;
+		return false;
+	}
+
+	char date[32];
+	time_t now = time(nullptr);
+	tm local;
+	localtime_s(&local, &now);
+	strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", &local);
+
+	stream << "{" << endl
+		<< "\t\"date\": \"" << date << "\"," << endl
+		<< "\t\"host\": {" << endl
+		<< "\t\t\"cpu\": \"" << Escape(GetCPUName()) << "\"," << endl
+		<< "\t\t\"threads\": " << thread::hardware_concurrency() << "," << endl
+		<< "\t\t\"isa\": \"" << CpuFeatures::GetIsaName(CpuFeatures::GetIsa()) << "\"," << endl
+		<< "\t\t\"isa_supported\": \"" << CpuFeatures::GetIsaName(CpuFeatures::Detect()) << "\"," << endl
+		<< "\t\t\"gl_vendor\": \"" << Escape((const char *)glGetString(GL_VENDOR)) << "\"," << endl
+		<< "\t\t\"gl_renderer\": \"" << Escape((const char *)glGetString(GL_RENDERER)) << "\"," << endl
+		<< "\t\t\"gl_version\": \"" << Escape((const char *)glGetString(GL_VERSION)) << "\"" << endl
+		<< "\t}," << endl
+		<< "\t\"quality\": \"" << Renderer::GetQualityName(options.quality) << "\"," << endl
+		<< "\t\"kernel_scene\": \"" << Escape(options.scenes[0]) << "\"," << endl
+		<< "\t\"reference\": \"" << Escape(options.reference) << "\"," << endl;
+
+	stream << "\t\"kernels\": [" << endl;
+	for (size_t i = 0; i < kernel_results.size(); i++)
+	{
+		const KernelResult &result = kernel_results[i];
+		stream << "\t\t{ \"name\": \"" << result.name << "\", \"evaluations_per_second\": " << result.evaluations_per_second
+			<< ", \"ns_per_evaluation\": " << (result.evaluations_per_second > 0 ? 1e9 / result.evaluations_per_second : 0)
+			<< " }" << (i + 1 < kernel_results.size() ? "," : "") << endl;
+	}
+	stream << "\t]," << endl;
+
+	stream << "\t\"frames\": [" << endl;
+	for (size_t i = 0; i < frame_results.size(); i++)
+	{
+		const FrameResult &result = frame_results[i];
+		stream << "\t\t{ \"scene\": \"" << Escape(result.scene) << "\", \"width\": " << result.width
+			<< ", \"height\": " << result.height << ", \"path\": \"" << (result.compute ? "compute" : "fragment")
+			<< "\", \"ms_per_pass\": " << result.pass_ms << ", \"rays_per_second\": " << result.rays_per_second
+			<< " }" << (i + 1 < frame_results.size() ? "," : "") << endl;
+	}
+	stream << "\t]," << endl;
+
+	stream << "\t\"encode\": { \"width\": " << options.sizes[0].first << ", \"height\": " << options.sizes[0].second
+		<< ", \"ms\": " << encode_seconds * 1e3 << ", \"megapixels_per_second\": "
+		<< (encode_seconds > 0 ? options.sizes[0].first * options.sizes[0].second / encode_seconds * 1e-6 : 0) << " }," << endl;
+
+	stream << "\t\"counters\": [" << endl;
+	for (size_t i = 0; i < phase_results.size(); i++)
+	{
+		const PhaseResult &result = phase_results[i];
+		const PerfSample &c = result.counters;
+		stream << "\t\t{ \"phase\": \"" << result.phase << "\", \"seconds\": " << result.seconds
+			<< ", \"cycles\": " << c.Get(PerfCounter::Cycles) << ", \"instructions\": " << c.Get(PerfCounter::Instructions)
+			<< ", \"ipc\": " << Ratio(c.Get(PerfCounter::Instructions), c.Get(PerfCounter::Cycles))
+			<< ", \"cache_references\": " << c.Get(PerfCounter::CacheReferences) << ", \"cache_misses\": " << c.Get(PerfCounter::CacheMisses)
+			<< ", \"cache_miss_rate\": " << Ratio(c.Get(PerfCounter::CacheMisses), c.Get(PerfCounter::CacheReferences))
+			<< ", \"branches\": " << c.Get(PerfCounter::Branches) << ", \"branch_misses\": " << c.Get(PerfCounter::BranchMisses)
+			<< ", \"branch_miss_rate\": " << Ratio(c.Get(PerfCounter::BranchMisses), c.Get(PerfCounter::Branches))
+			<< " }" << (i + 1 < phase_results.size() ? "," : "") << endl;
+	}
+	stream << "\t]," << endl;
+
+	stream << "\t\"convergence\": [" << endl;
+	for (size_t i = 0; i < convergence_results.size(); i++)
+	{
+		const ConvergenceResult &result = convergence_results[i];
+		stream << "\t\t{ \"path\": \"" << (result.compute ? "compute" : "fragment") << "\", \"quality\": \""
+			<< Renderer::GetQualityName(result.quality) << "\", \"passes\": " << result.passes
+			<< ", \"samples_per_pixel\": " << result.samples << ", \"seconds\": " << result.seconds
+			<< ", \"rmse\": " << result.error.rmse << ", \"relmse\": " << result.error.relmse
+			<< ", \"display_error\": " << result.error.display << ", \"efficiency\": " << result.efficiency
+			<< " }" << (i + 1 < convergence_results.size() ? "," : "") << endl;
+	}
+	stream << "\t]" << endl
+		<< "}" << endl;
+
+	if (!stream)
+	{
+		cout << "failed to write " << options.output << endl;
+		return false;
+	}
+	cout << "Benchmark written to " << options.output << endl;
+	return true;
+}
+
+bool Benchmark::WriteCSV() const
+{
+	size_t extension = options.output.find_last_of('.');
+	string file = options.output.substr(0, extension) + "_convergence.csv";
+	ofstream stream(file);
+	if (!stream)
+	{
+		cout << "failed to open " << file << endl;
+		return false;
+	}
+
+	stream << "path,quality,passes,samples_per_pixel,seconds,rmse,relmse,display_error,efficiency" << endl;
+	for (const ConvergenceResult &result : convergence_results)
+	{
+		stream << (result.compute ? "compute" : "fragment") << "," << Renderer::GetQualityName(result.quality) << ","
+			<< result.passes << "," << result.samples << "," << result.seconds << "," << result.error.rmse << ","
+			<< result.error.relmse << "," << result.error.display << "," << result.efficiency << endl;
+	}
+
+	if (!stream)
+	{
+		cout << "failed to write " << file << endl;
+		return false;
+	}
+	cout << "Convergence written to " << file << endl;
+	return true;
+}
+
+string Benchmark::GetCPUName()
+{
+	// brand string from the extended cpuid leaves
+	int info[4];
+	CpuFeatures::Cpuid(info, 0x80000000);
+	if ((unsigned int)info[0] < 0x80000004)
+		return "unknown";
+
+	char brand[49] = {};
+	for (int i = 0; i < 3; i++)
+	{
+		CpuFeatures::Cpuid(info, 0x80000002 + i);
+		memcpy(brand + i * 16, info, sizeof(info));
+	}
+	string name = brand;
+	size_t start = name.find_first_not_of(' ');
+	return start == string::npos ? "unknown" : name.substr(start);
+}
+
+double Benchmark::Ratio(unsigned long long count, unsigned long long total)
+{
+	return total > 0 ? (double)count / total : 0;
+}
+
+string Benchmark::Escape(const string &text)
+{
+	string escaped;
+	for (char c : text)
+	{
+		if (c == '"' || c == '\\')
+			escaped += '\\';
+		if ((unsigned char)c >= 0x20)
+			escaped += c;
+	}
+	return escaped;
+}
@@ -0,0 +1,110 @@
+#pragma once
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Renderer.h"
+#include "Metrics.h"
+#include "PerfCounters.h"
+
+// timed accumulation passes per frame benchmark, kept below MIN_TILE_ITERATION so the
+// compute path still renders every tile
+#define BENCH_PASSES 4
+// kernel dispatches grow until they take this many seconds or reach BENCH_MAX_GROUPS
+#define BENCH_MIN_TIME 0.02
+#define BENCH_MAX_GROUPS 65536
+#define BENCH_GROUP_SIZE 64 // local size of shader/bench.comp
+
+struct BenchOptions
+{
+	std::string output;
+	// frame sizes and scenes, the defaults are used when none are given,
+	// kernels run on the first scene
+	std::vector<std::pair<int, int>> sizes;
+	std::vector<std::string> scenes;
+	Quality quality = Quality::Default;
+	int passes = BENCH_PASSES;
+	// converged pfm of the first scene with the light in the middle, enables the convergence runs
+	std::string reference;
+	// count cpu hardware events of every stage
+	bool counters = false;
+};
+
+// measures the shader functions in isolation, single rays through march() and full accumulation
+// passes of both render paths, and writes the results with the host description as json so
+// runs on different builds and machines can be compared. given a reference image it also
+// tracks the error over time and samples of every render path and quality preset, so changes
+// are judged by quality per second. the tone mapping and png encoding of a frame is timed too,
+// and with hardware counters every stage reports its ipc and miss rates
+class Benchmark
+{
+public:
+	Benchmark(const BenchOptions &options) : options(options) { };
+
+	// parse the options following --bench, returns false on error
+	static bool ParseOptions(int argc, const char *const argv[], BenchOptions &options);
+
+	bool Run();
+
+private:
+	struct KernelResult
+	{
+		std::string name;
+		double evaluations_per_second;
+	};
+
+	struct FrameResult
+	{
+		std::string scene;
+		int width, height;
+		bool compute;
+		double pass_ms;
+		double rays_per_second;
+	};
+
+	struct PhaseResult
+	{
+		std::string phase;
+		double seconds;
+		PerfSample counters;
+	};
+
+	// one point of a convergence curve
+	struct ConvergenceResult
+	{
+		bool compute;
+		Quality quality;
+		int passes;
+		int samples; // per pixel
+		double seconds; // render time of all passes so far
+		ImageError error;
+		double efficiency;
+	};
+
+	BenchOptions options;
+	std::vector<KernelResult> kernel_results;
+	std::vector<FrameResult> frame_results;
+	std::vector<ConvergenceResult> convergence_results;
+	std::vector<PhaseResult> phase_results;
+	std::unique_ptr<PerfCounters> counters;
+	double encode_seconds = 0;
+
+	bool RunKernels();
+	bool RunFrames();
+	bool RunConvergence();
+	// tone map and write a rendered frame of the first size to <output>_encode.png
+	bool RunEncode();
+	// seconds the stage took, its counters are recorded when counting
+	double CountPhase(const char *phase, const std::function<void()> &stage);
+	// evaluations per second of one kernel program
+	static double TimeKernel(Shader &shader, int loop);
+	// seconds until the gl commands issued by the function have finished
+	static double TimeGL(const std::function<void()> &commands);
+	bool WriteJSON() const;
+	// convergence curves next to the json as <output>_convergence.csv
+	bool WriteCSV() const;
+
+	static std::string GetCPUName();
+	static std::string Escape(const std::string &text);
+	static double Ratio(unsigned long long count, unsigned long long total);
+};
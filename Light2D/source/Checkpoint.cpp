@@ -0,0 +1,212 @@
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
+#include <stdio.h>
+#include <string.h>
+#include <iostream>
+#include <vector>
+
+#include "Checkpoint.h"
+#include "Trace.h"
+#include "Platform.h"
+
+using namespace std;
+
+#define CHECKPOINT_VERSION 2
+
+Checkpoint::Checkpoint(const char *checkpoint_file, unsigned long long scene_hash) : file(checkpoint_file), scene_hash(scene_hash)
+{
+	memcpy(header.magic, "L2DC", 4);
+	header.version = CHECKPOINT_VERSION;
+}
+
+Checkpoint::~Checkpoint()
+{
+	Wait();
+	if (pixel_buffer != 0)
+	{
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, pixel_buffer);
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		glDeleteBuffers(1, &pixel_buffer);
+	}
+}
+
+bool Checkpoint::Load(Renderer &renderer, float &light_x, float &light_y)
+{
+	FILE *stream = nullptr;
+	fopen_s(&stream, file.c_str(), "rb");
+	if (stream == nullptr)
+		return false;
+
+	Header saved;
+	bool valid = fread(&saved, sizeof(Header), 1, stream) == 1
+		&& memcmp(saved.magic, header.magic, 4) == 0 && saved.version == CHECKPOINT_VERSION;
+	if (valid && (saved.scene_hash != scene_hash || saved.width != renderer.GetWidth() || saved.height != renderer.GetHeight()))
+	{
+		cout << "checkpoint " << file << " is for a different scene or size" << endl;
+		valid = false;
+	}
+
+	vector<float> rgba;
+	vector<unsigned int> tiles;
+	if (valid)
+	{
+		rgba.resize((size_t)saved.width * saved.height * 4);
+		valid = fread(rgba.data(), sizeof(float), rgba.size(), stream) == rgba.size();
+	}
+	if (valid && saved.compute_path)
+	{
+		// dispatch command followed by the tiles
+		tiles.resize(3);
+		valid = fread(tiles.data(), sizeof(unsigned int), 3, stream) == 3 && tiles[0] + 3 <= renderer.GetTileListSize();
+		if (valid)
+		{
+			tiles.resize(tiles[0] + 3);
+			valid = fread(tiles.data() + 3, sizeof(unsigned int), tiles[0], stream) == tiles[0];
+		}
+	}
+	fclose(stream);
+	if (!valid)
+		return false;
+	// converged tiles must stay inactive, otherwise the resumed render differs from an uninterrupted one
+	if (!renderer.SetComputePath(saved.compute_path != 0))
+	{
+		cout << "checkpoint " << file << " needs the compute shader" << endl;
+		return false;
+	}
+
+	renderer.Clear();
+	renderer.SetLight(saved.light_x, saved.light_y);
+	renderer.LoadAccumulation(rgba.data(), saved.iteration);
+	if (saved.compute_path)
+		renderer.LoadTileList(tiles.data());
+	light_x = saved.light_x;
+	light_y = saved.light_y;
+	header = saved;
+
+	cout << "Resumed " << file << " at iteration " << saved.iteration << endl;
+	return true;
+}
+
+bool Checkpoint::Capture(const Renderer &renderer, float light_x, float light_y)
+{
+	Update();
+	if (IsPending())
+		return false;
+
+	// immutable storage, reallocated when the size changes
+	size_t image_size = (size_t)renderer.GetWidth() * renderer.GetHeight() * 4 * sizeof(float);
+	size_t size = image_size + renderer.GetTileListSize() * sizeof(unsigned int);
+	if (size != buffer_size)
+	{
+		if (pixel_buffer != 0)
+		{
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, pixel_buffer);
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+			glDeleteBuffers(1, &pixel_buffer);
+		}
+		GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glGenBuffers(1, &pixel_buffer);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, pixel_buffer);
+		glBufferStorage(GL_PIXEL_PACK_BUFFER, size, nullptr, flags);
+		mapped = (const float *)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, flags);
+		buffer_size = size;
+	}
+
+	header.width = renderer.GetWidth();
+	header.height = renderer.GetHeight();
+	header.iteration = renderer.GetIteration();
+	header.light_x = light_x;
+	header.light_y = light_y;
+	header.compute_path = renderer.IsComputePath();
+	header.scene_hash = scene_hash;
+
+	// with a pack buffer bound the readback is queued and lands in the buffer asynchronously
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, pixel_buffer);
+	renderer.ReadAccumulation(nullptr);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	if (header.compute_path)
+		renderer.CopyTileList(pixel_buffer, image_size);
+	fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	return true;
+}
+
+void Checkpoint::Update(bool wait)
+{
+	if (fence == nullptr)
+		return;
+
+	GLenum status = glClientWaitSync((GLsync)fence, GL_SYNC_FLUSH_COMMANDS_BIT, wait ? GL_TIMEOUT_IGNORED : 0);
+	if (status == GL_TIMEOUT_EXPIRED)
+		return;
+	glDeleteSync((GLsync)fence);
+	fence = nullptr;
+	writing = async(launch::async, &Checkpoint::Write, this);
+}
+
+void Checkpoint::Wait()
+{
+	Update(true);
+	if (writing.valid())
+		writing.wait();
+}
+
+bool Checkpoint::IsPending() const
+{
+	return fence != nullptr || (writing.valid() && writing.wait_for(chrono::seconds(0)) != future_status::ready);
+}
+
+bool Checkpoint::Write()
+{
+	Trace::SetThreadName("checkpoint writer");
+	TRACE_SCOPE("checkpoint write");
+	string temp = file + ".tmp";
+	FILE *stream = nullptr;
+	fopen_s(&stream, temp.c_str(), "wb");
+	if (stream == nullptr)
+	{
+		cout << "failed to write checkpoint " << temp << endl;
+		return false;
+	}
+	size_t count = (size_t)header.width * header.height * 4;
+	bool success = fwrite(&header, sizeof(Header), 1, stream) == 1
+		&& fwrite(mapped, sizeof(float), count, stream) == count;
+	if (header.compute_path)
+	{
+		const unsigned int *tiles = (const unsigned int *)(mapped + count);
+		success = success && fwrite(tiles, sizeof(unsigned int), tiles[0] + 3, stream) == tiles[0] + 3;
+	}
+	success = fclose(stream) == 0 && success;
+
+#ifdef _WIN32
+	success = success && MoveFileExA(temp.c_str(), file.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+#else
+	success = success && rename(temp.c_str(), file.c_str()) == 0;
+#endif
+	if (!success)
+		cout << "failed to write checkpoint " << file << endl;
+	return success;
+}
+
+unsigned long long Checkpoint::HashFile(const char *file, unsigned long long hash)
+{
+	FILE *stream = nullptr;
+	fopen_s(&stream, file, "rb");
+	if (stream == nullptr)
+		return hash;
+
+	unsigned char buffer[65536];
+	size_t count;
+	while ((count = fread(buffer, 1, sizeof(buffer), stream)) > 0)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			hash = (hash ^ buffer[i]) * 1099511628211ull;
+		}
+	}
+	fclose(stream);
+	return hash;
+}
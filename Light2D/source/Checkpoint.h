@@ -0,0 +1,60 @@
+#pragma once
+#include <future>
+#include <string>
+#include "Renderer.h"
+
+// saves the progressive accumulation to disk so a render can resume after a restart,
+// the readback goes through a persistently mapped pixel buffer and the file is written
+// on a worker thread so the render thread never waits for either
+class Checkpoint
+{
+public:
+	// scene_hash identifies everything besides size and light that affects the image
+	Checkpoint(const char *checkpoint_file, unsigned long long scene_hash);
+	// remove copy constructor/assignment
+	Checkpoint(const Checkpoint &) = delete;
+	Checkpoint &operator=(const Checkpoint &) = delete;
+	// finishes a pending checkpoint
+	~Checkpoint();
+
+	// restore the accumulation and light of a checkpoint matching the renderer size and scene,
+	// a compute path render also restores the path and its tiles still accumulating
+	bool Load(Renderer &renderer, float &light_x, float &light_y);
+	// start saving the current accumulation, returns false while the previous one is still pending
+	bool Capture(const Renderer &renderer, float light_x, float light_y);
+	// hand a finished readback to the writer, wait blocks until the gpu is done
+	void Update(bool wait = false);
+	bool IsPending() const;
+	// block until the pending checkpoint is on disk
+	void Wait();
+
+	// fnv-1a of the file contents continuing from hash
+	static unsigned long long HashFile(const char *file, unsigned long long hash = 14695981039346656037ull);
+
+private:
+	struct Header
+	{
+		char magic[4];
+		unsigned int version;
+		int width, height;
+		unsigned int iteration;
+		float light_x, light_y;
+		// the active tile list of the compute path follows the accumulation when set
+		unsigned int compute_path;
+		unsigned long long scene_hash;
+	};
+
+	std::string file;
+	unsigned long long scene_hash;
+	Header header = {};
+
+	// accumulation followed by room for the tile list
+	unsigned int pixel_buffer = 0;
+	size_t buffer_size = 0;
+	const float *mapped = nullptr;
+	void *fence = nullptr;
+	std::future<bool> writing;
+
+	// write to a temporary file and replace the checkpoint so a crash never leaves it half written
+	bool Write();
+};
@@ -0,0 +1,95 @@
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#include <string.h>
+#include <iostream>
+
+#include "CpuFeatures.h"
+#include "Platform.h"
+
+using namespace std;
+
+// indexed by Isa
+static const char *isa_names[] = { "scalar", "sse4.2", "avx2", "avx512" };
+
+static Isa selected_isa = CpuFeatures::Detect();
+
+// extended control register 0, the register states the os saves
+static unsigned long long GetXcr0()
+{
+#ifdef _MSC_VER
+	return _xgetbv(0);
+#else
+	// the intrinsic needs the xsave target, the instruction itself only osxsave
+	unsigned int eax, edx;
+	__asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return ((unsigned long long)edx << 32) | eax;
+#endif
+}
+
+void CpuFeatures::Cpuid(int info[4], int leaf, int subleaf)
+{
+#ifdef _MSC_VER
+	__cpuidex(info, leaf, subleaf);
+#else
+	__cpuid_count(leaf, subleaf, info[0], info[1], info[2], info[3]);
+#endif
+}
+
+Isa CpuFeatures::Detect()
+{
+	int info[4];
+	Cpuid(info, 0);
+	int max_leaf = info[0];
+	Cpuid(info, 1);
+	// the sse4.2 kernels also use ssse3
+	bool sse42 = (info[2] & (1 << 20)) != 0 && (info[2] & (1 << 9)) != 0;
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+	if (!sse42)
+		return Isa::Scalar;
+
+	// wider registers also need the os to save their state on context switches
+	unsigned long long xcr0 = osxsave ? GetXcr0() : 0;
+	bool ymm_state = (xcr0 & 0x06) == 0x06;
+	bool zmm_state = (xcr0 & 0xe6) == 0xe6;
+	if (max_leaf < 7 || !avx || !ymm_state)
+		return Isa::SSE42;
+
+	Cpuid(info, 7, 0);
+	bool avx2 = (info[1] & (1 << 5)) != 0;
+	bool avx512 = (info[1] & (1 << 16)) != 0 && (info[1] & (1 << 30)) != 0; // f and bw
+	if (avx2 && avx512 && zmm_state)
+		return Isa::AVX512;
+	return avx2 ? Isa::AVX2 : Isa::SSE42;
+}
+
+Isa CpuFeatures::GetIsa()
+{
+	return selected_isa;
+}
+
+bool CpuFeatures::SetIsa(const char *name)
+{
+	for (int i = 0; i <= (int)Isa::AVX512; i++)
+	{
+		if (_stricmp(name, isa_names[i]) != 0)
+			continue;
+		if (i > (int)Detect())
+		{
+			cout << name << " is not supported, this cpu runs up to " << GetIsaName(Detect()) << endl;
+			return false;
+		}
+		selected_isa = (Isa)i;
+		return true;
+	}
+	cout << "unknown instruction set " << name << endl;
+	return false;
+}
+
+const char *CpuFeatures::GetIsaName(Isa isa)
+{
+	return isa_names[(int)isa];
+}
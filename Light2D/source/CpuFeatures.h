@@ -0,0 +1,27 @@
+#pragma once
+
+// instruction sets cpu kernels are compiled for, from oldest to newest
+enum class Isa { Scalar, SSE42, AVX2, AVX512 };
+
+// msvc compiles intrinsics of any instruction set anywhere, gcc and clang need the
+// target of every kernel using them
+#ifdef _MSC_VER
+#define ISA_TARGET(isa)
+#else
+#define ISA_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+// picks the best kernel variants the cpu and os support once at start-up
+class CpuFeatures
+{
+public:
+	// the newest instruction set usable on this machine
+	static Isa Detect();
+	// variant used by the dispatched kernels, the detected one unless overridden
+	static Isa GetIsa();
+	// force an older variant for testing, fails for unknown or unsupported names
+	static bool SetIsa(const char *name);
+	static const char *GetIsaName(Isa isa);
+	// cpuid leaf and subleaf into eax, ebx, ecx, edx
+	static void Cpuid(int info[4], int leaf, int subleaf = 0);
+};
@@ -0,0 +1,92 @@
+#include <algorithm>
+#include "FrameScheduler.h"
+
+using namespace std::chrono;
+
+FrameScheduler::FrameScheduler(double frame_budget) : frame_budget(frame_budget)
+{
+	glGenQueries(TIMER_QUERIES, queries);
+}
+
+FrameScheduler::~FrameScheduler()
+{
+	glDeleteQueries(TIMER_QUERIES, queries);
+}
+
+void FrameScheduler::BeginFrame()
+{
+	CollectQueries();
+	frame_start = clock::now();
+	frame_passes = 0;
+}
+
+void FrameScheduler::Reset()
+{
+	pass_cost = 0;
+	query_stale = query_pending;
+}
+
+bool FrameScheduler::HasBudget()
+{
+	if (frame_passes == 0)
+	{
+		return true;
+	}
+	// without a measurement the cost of a pass is unknown, so no more than one pass
+	// is submitted until the first timer query comes back
+	if (pass_cost <= 0)
+	{
+		return false;
+	}
+	// submitted passes run asynchronously, so take the larger of the cpu time
+	// spent so far and the gpu time the submitted passes are expected to take
+	double elapsed = duration_cast<duration<double>>(clock::now() - frame_start).count();
+	double estimate = std::max(elapsed, frame_passes * pass_cost);
+	return estimate + pass_cost <= frame_budget;
+}
+
+void FrameScheduler::BeginPass()
+{
+	// skip timing this pass if all queries are still waiting for results
+	if (query_pending < TIMER_QUERIES)
+	{
+		glBeginQuery(GL_TIME_ELAPSED, queries[(query_head + query_pending) % TIMER_QUERIES]);
+		query_active = true;
+	}
+}
+
+void FrameScheduler::EndPass()
+{
+	if (query_active)
+	{
+		glEndQuery(GL_TIME_ELAPSED);
+		query_pending++;
+		query_active = false;
+	}
+	frame_passes++;
+}
+
+void FrameScheduler::CollectQueries()
+{
+	while (query_pending > 0)
+	{
+		unsigned int query = queries[query_head];
+		int available = 0;
+		glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+		{
+			break;
+		}
+
+		GLuint64 nanoseconds = 0;
+		glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+		double cost = nanoseconds * 1e-9;
+		if (query_stale > 0)
+			query_stale--;
+		else
+			pass_cost = pass_cost > 0 ? pass_cost * 0.8 + cost * 0.2 : cost;
+
+		query_head = (query_head + 1) % TIMER_QUERIES;
+		query_pending--;
+	}
+}
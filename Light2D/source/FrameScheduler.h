@@ -0,0 +1,47 @@
+#pragma once
+#include <glad/glad.h>
+#include <chrono>
+
+#define TIMER_QUERIES 8 // gpu timer queries in flight, results are read back a few frames late
+
+class FrameScheduler
+{
+public:
+	// frame_budget is the time in seconds a frame may spend on render passes before present
+	FrameScheduler(double frame_budget);
+	// remove copy constructor/assignment
+	FrameScheduler(const FrameScheduler &) = delete;
+	FrameScheduler &operator=(const FrameScheduler &) = delete;
+	~FrameScheduler();
+
+	void BeginFrame();
+	// forget the measured pass cost, e.g. after a resize changed it,
+	// until a new measurement arrives every frame runs a single pass
+	void Reset();
+	// true if another pass is estimated to finish within the frame budget,
+	// the first pass of a frame is always allowed
+	bool HasBudget();
+	// bracket a render pass with a gpu timer query
+	void BeginPass();
+	void EndPass();
+
+	int GetFramePasses() const { return frame_passes; }
+	double GetPassCost() const { return pass_cost; }
+
+private:
+	typedef std::chrono::high_resolution_clock clock;
+
+	double frame_budget;
+	double pass_cost = 0; // moving average of measured gpu seconds per pass, 0 until measured
+	clock::time_point frame_start;
+	int frame_passes = 0;
+
+	// ring buffer of issued queries, oldest pending query at query_head
+	unsigned int queries[TIMER_QUERIES];
+	int query_head = 0;
+	int query_pending = 0;
+	int query_stale = 0; // pending queries issued before the last Reset
+	bool query_active = false;
+
+	void CollectQueries();
+};
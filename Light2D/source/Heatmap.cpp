@@ -0,0 +1,100 @@
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include "Heatmap.h"
+#include "PngWriter.h"
+#include "Renderer.h"
+
+using namespace std;
+
+// file suffixes in ProfileCounter order
+static const char *counter_names[PROFILE_COUNTERS] = { "steps", "scene_calls", "max_depth", "pushes", "exhausted" };
+
+bool Heatmap::Write(const char *prefix, int width, int height, const unsigned int *counters)
+{
+	size_t pixels = (size_t)width * height;
+	string histogram_file = string(prefix) + "_histogram.csv";
+	ofstream histogram(histogram_file);
+	if (!histogram)
+	{
+		cout << "failed to open " << histogram_file << endl;
+		return false;
+	}
+	histogram << "counter,bin_start,bin_end,pixels" << endl;
+
+	bool success = true;
+	for (int c = 0; c < PROFILE_COUNTERS; c++)
+	{
+		unsigned int max_value = 0;
+		unsigned long long total = 0;
+		for (size_t i = 0; i < pixels; i++)
+		{
+			unsigned int value = counters[i * PROFILE_COUNTERS + c];
+			max_value = max(max_value, value);
+			total += value;
+		}
+
+		// equal width bins over [0, max], the last bin includes the max
+		vector<size_t> bins(HEATMAP_BINS);
+		for (size_t i = 0; i < pixels; i++)
+		{
+			unsigned long long value = counters[i * PROFILE_COUNTERS + c];
+			bins[max_value > 0 ? min((size_t)(value * HEATMAP_BINS / max_value), (size_t)HEATMAP_BINS - 1) : 0]++;
+		}
+		for (int b = 0; b < HEATMAP_BINS; b++)
+		{
+			histogram << counter_names[c] << "," << (double)max_value * b / HEATMAP_BINS << ","
+				<< (double)max_value * (b + 1) / HEATMAP_BINS << "," << bins[b] << endl;
+		}
+
+		string png_file = string(prefix) + "_" + counter_names[c] + ".png";
+		success = WriteImage(png_file, width, height, counters, c, max_value) && success;
+		cout << png_file << " max " << max_value << " mean " << (double)total / pixels << endl;
+	}
+
+	success = !!histogram && success;
+	if (!histogram)
+		cout << "failed to write " << histogram_file << endl;
+	return success;
+}
+
+bool Heatmap::WriteImage(const string &png_file, int width, int height, const unsigned int *counters,
+	int counter, unsigned int max_value)
+{
+	// counters are bottom to top like gl, png rows top to bottom
+	vector<unsigned char> rgb((size_t)width * height * 3);
+	for (int y = 0; y < height; y++)
+	{
+		const unsigned int *src = counters + (size_t)(height - 1 - y) * width * PROFILE_COUNTERS + counter;
+		unsigned char *dst = rgb.data() + (size_t)y * width * 3;
+		for (int x = 0; x < width; x++)
+		{
+			FalseColour(max_value > 0 ? (float)src[x * PROFILE_COUNTERS] / max_value : 0, dst + x * 3);
+		}
+	}
+	bool success = PngWriter::Write(png_file.c_str(), width, height, 3, 8, rgb.data());
+	if (!success)
+		cout << "failed to write " << png_file << endl;
+	return success;
+}
+
+void Heatmap::FalseColour(float t, unsigned char *rgb)
+{
+	static const float stops[][3] = {
+		{ 0, 0, 0 },
+		{ 0.1f, 0.1f, 0.8f },
+		{ 0.8f, 0.1f, 0.7f },
+		{ 1, 0.55f, 0.1f },
+		{ 1, 1, 0.6f },
+	};
+	const int last = sizeof(stops) / sizeof(stops[0]) - 1;
+	float x = min(max(t, 0.f), 1.f) * last;
+	int i = min((int)x, last - 1);
+	float f = x - i;
+	for (int c = 0; c < 3; c++)
+	{
+		rgb[c] = (unsigned char)((stops[i][c] * (1 - f) + stops[i + 1][c] * f) * 255 + 0.5f);
+	}
+}
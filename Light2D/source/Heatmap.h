@@ -0,0 +1,20 @@
+#pragma once
+#include <string>
+
+#define HEATMAP_BINS 32
+
+// exports the per pixel cost counters of a profiling render, every counter is written as a
+// false colour png scaled to its largest value, e.g. prefix_steps.png, and all histograms
+// go to prefix_histogram.csv
+class Heatmap
+{
+public:
+	// counters as read by Renderer::ReadProfile
+	static bool Write(const char *prefix, int width, int height, const unsigned int *counters);
+
+private:
+	static bool WriteImage(const std::string &png_file, int width, int height, const unsigned int *counters,
+		int counter, unsigned int max_value);
+	// black, blue, magenta, orange, yellow ramp for t in [0, 1]
+	static void FalseColour(float t, unsigned char *rgb);
+};
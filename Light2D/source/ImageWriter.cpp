@@ -0,0 +1,62 @@
+#include <math.h>
+#include <string.h>
+#include <iostream>
+#include <vector>
+
+#include "ImageWriter.h"
+#include "PngWriter.h"
+#include "Platform.h"
+
+bool ImageWriter::Write(const char *image_file, int width, int height, const float *rgb, float exposure, unsigned int threads)
+{
+	const char *extension = strrchr(image_file, '.');
+	if (extension != nullptr && _stricmp(extension, ".pfm") == 0)
+	{
+		return WritePFM(image_file, width, height, rgb);
+	}
+	if (extension != nullptr && _stricmp(extension, ".png") == 0)
+	{
+		return WritePNG(image_file, width, height, rgb, exposure, threads);
+	}
+	std::cout << "unsupported image format " << image_file << std::endl;
+	return false;
+}
+
+bool ImageWriter::WritePFM(const char *image_file, int width, int height, const float *rgb)
+{
+	FILE *stream;
+	fopen_s(&stream, image_file, "wb");
+	if (stream == nullptr)
+	{
+		std::cout << "failed to open image " << image_file << std::endl;
+		return false;
+	}
+	// negative scale marks little endian data, pfm rows are bottom to top like gl
+	fprintf(stream, "PF\n%d %d\n-1.0\n", width, height);
+	size_t size = (size_t)width * height * 3;
+	bool success = fwrite(rgb, sizeof(float), size, stream) == size;
+	fclose(stream);
+	return success;
+}
+
+bool ImageWriter::WritePNG(const char *image_file, int width, int height, const float *rgb, float exposure, unsigned int threads)
+{
+	std::vector<unsigned char> pixels((size_t)width * height * 3);
+	ToneMap(rgb, width, height, exposure, pixels.data());
+	return PngWriter::Write(image_file, width, height, 3, 8, pixels.data(), threads);
+}
+
+void ImageWriter::ToneMap(const float *rgb, int width, int rows, float exposure, unsigned char *pixels)
+{
+	// same exponential tone mapping as screen.frag
+	for (int y = 0; y < rows; y++)
+	{
+		const float *src = rgb + (size_t)(rows - 1 - y) * width * 3;
+		unsigned char *dst = pixels + (size_t)y * width * 3;
+		for (int i = 0; i < width * 3; i++)
+		{
+			float c = 1 - expf(-src[i] * exposure);
+			dst[i] = (unsigned char)(c * 255 + 0.5f);
+		}
+	}
+}
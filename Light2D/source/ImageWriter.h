@@ -0,0 +1,14 @@
+#pragma once
+
+class ImageWriter
+{
+public:
+	// write rgb float pixels with rows ordered bottom to top, format is picked from the extension
+	static bool Write(const char *image_file, int width, int height, const float *rgb, float exposure, unsigned int threads = 0);
+	// portable float map, stores the hdr radiance unchanged
+	static bool WritePFM(const char *image_file, int width, int height, const float *rgb);
+	// 8 bit png with the same exposure and tone mapping as screen.frag, encoded by threads, 0 uses all
+	static bool WritePNG(const char *image_file, int width, int height, const float *rgb, float exposure, unsigned int threads = 0);
+	// convert rows of rgb radiance from bottom to top order into 8 bit rows from top to bottom
+	static void ToneMap(const float *rgb, int width, int rows, float exposure, unsigned char *pixels);
+};
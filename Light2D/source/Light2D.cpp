@@ -1,38 +1,55 @@
 ﻿#include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <chrono>
+#include <future>
 #include <iostream>
-
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include "Shader.h"
 #include "NoiseGenerator.h"
+#include "NoiseAsset.h"
+#include "FrameScheduler.h"
+#include "Renderer.h"
+#include "BatchRenderer.h"
+#include "Checkpoint.h"
+#include "Benchmark.h"
+#include "Trace.h"
+#include "CpuFeatures.h"
 
 using namespace std::chrono;
 
 #define DEFAULT_WIDTH 1920
 #define DEFAULT_HEIGHT 1080
 
-#define ITERATION 32
+// seconds spent on accumulation passes per presented frame
+#define FRAME_BUDGET (1. / 60.)
+
+#define CHECKPOINT_FILE "light2d.checkpoint"
+// seconds between checkpoints of an unfinished render
+#define CHECKPOINT_INTERVAL 10.
 
-unsigned int colorBuffer;
-unsigned int iteration;
+int previewLevel;
+// set by input callbacks, consumed once per frame so bursts of events only restart once
+bool sceneDirty = true;
+// new content was rendered or the window needs repainting
+bool presentPending = true;
 
 int windowWidth = DEFAULT_WIDTH, windowHeight = DEFAULT_HEIGHT;
 double cursorX, cursorY;
 bool editMode = true;
+bool computePath = false;
+bool traceRequested = false;
+
 void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
-	glViewport(0, 0, width, height);
 	windowWidth = width;
 	windowHeight = height;
-
-	glBindTexture(GL_TEXTURE_2D, colorBuffer);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
-	glBindTexture(GL_TEXTURE_2D, 0);	
-
-	iteration = 0;
+	sceneDirty = true;
 
 	std::cout << "Resize viewport to " << width << " x " << height << std::endl;
 }
@@ -43,17 +60,17 @@ void cursor_pos_callback(GLFWwindow* window, double xpos, double ypos)
 	{
 		cursorX = xpos;
 		cursorY = windowHeight - ypos;
-		iteration = 0;
-
-		glBindTexture(GL_TEXTURE_2D, colorBuffer);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, windowWidth, windowHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
-		glBindTexture(GL_TEXTURE_2D, 0);
-		glClearTexImage(colorBuffer, 0, GL_BGRA, GL_UNSIGNED_BYTE, nullptr);
+		sceneDirty = true;
 	}
 
 	std::cout << "Cursor pos " << xpos << ", " << ypos << std::endl;
 }
 
+void window_refresh_callback(GLFWwindow* window)
+{
+	presentPending = true;
+}
+
 void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
 {
 	if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS)
@@ -62,218 +79,430 @@ void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
 	}
 }
 
-int main(int argc, char * argv[])
-{	
-	//NoiseGenerator generator(42);
-	//generator.CreateFloatNoiseTexture("gray.png", 1024);
-	
-	glfwInit();
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
-	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-	GLFWwindow* window = glfwCreateWindow(DEFAULT_WIDTH, DEFAULT_HEIGHT, "Light2D", NULL, NULL);
-	if (window == NULL)
+void key_callback(GLFWwindow*, int key, int, int action, int)
+{
+	if (key == GLFW_KEY_C && action == GLFW_PRESS)
 	{
-		std::cout << "Failed to create GLFW window" << std::endl;
-		glfwTerminate();
-		return -1;
+		computePath = !computePath;
+		sceneDirty = true;
 	}
-	glfwMakeContextCurrent(window);
-
-	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+	if (key == GLFW_KEY_T && action == GLFW_PRESS)
 	{
-		std::cout << "Failed to initialize GLAD" << std::endl;
-		return -1;
+		traceRequested = true;
 	}
+}
 
-	glViewport(0, 0, DEFAULT_WIDTH, DEFAULT_HEIGHT);
-	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-	glfwSetCursorPosCallback(window, cursor_pos_callback);
-	glfwSetMouseButtonCallback(window, mouse_button_callback);
-
-	// load noise texture
-	int width, height, nrChannels;
-	stbi_us *data = stbi_load_16("noise_map.png", &width, &height, &nrChannels, 0);
-	for (int i = 0; i < width * height * nrChannels; i++)
+// render the jobs given on the command line or in a manifest and exit
+int run_batch(int argc, char * argv[])
+{
+	std::vector<RenderJob> jobs;
+	if (strcmp(argv[1], "--manifest") == 0 && (argc == 3 || (argc == 4 && strcmp(argv[3], "--record") == 0)))
 	{
-		data[i] = ((data[i] & 0xff) << 8) + ((data[i] & 0xff00) >> 8);
+		if (!BatchRenderer::LoadManifest(argv[2], jobs))
+			return -1;
+		// re-record every golden image of the manifest
+		for (RenderJob &job : jobs)
+			job.record = job.record || (argc == 4 && !job.compare.empty());
 	}
+	else
+	{
+		RenderJob job;
+		if (!BatchRenderer::ParseJob(argc - 1, argv + 1, job))
+		{
+			BatchRenderer::PrintUsage();
+			return -1;
+		}
+		jobs.push_back(job);
+	}
+	if (jobs.empty())
+		return 0;
+
+	// out-of-core jobs only need a tile sized renderer
+	bool tiled = !jobs[0].accumulation.empty();
+	Renderer renderer(tiled ? jobs[0].tile_size : jobs[0].width, tiled ? jobs[0].tile_size : jobs[0].height,
+		jobs[0].scene.c_str(), jobs[0].quality);
+	BatchRenderer batch(renderer);
+	int failed = 0;
+	for (const RenderJob &job : jobs)
+	{
+		Trace::Enable(!job.trace.empty());
+		if (!batch.Run(job))
+			failed++;
+		if (!job.trace.empty() && !Trace::Dump(job.trace.c_str()))
+			failed++;
+	}
+	return failed > 0 ? -1 : 0;
+}
 
-	//glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+// run the benchmark suite and write its json report
+int run_bench(int argc, char * argv[])
+{
+	BenchOptions options;
+	if (!Benchmark::ParseOptions(argc - 2, argv + 2, options))
+	{
+		BatchRenderer::PrintUsage();
+		return -1;
+	}
+	Benchmark benchmark(options);
+	return benchmark.Run() ? 0 : -1;
+}
 
-	float vertices[] = {
-		// positions		// texture coords
-		 1.f,  1.f, 0.f,	1.f, 1.f,	// top right
-		 1.f, -1.f, 0.f,	1.f, 0.f,	// bottom right
-		-1.f, -1.f, 0.f,	0.f, 0.f,	// bottom left
-		-1.f,  1.f, 0.f,	0.f, 1.f	// top left 
-	};
-	unsigned int indices[] = {
-		0, 1, 3,   // first triangle
-		1, 2, 3    // second triangle
+// render an out-of-core image in one process and as shards in separate processes merged by another,
+// one shard stops after its first pass and one never starts like lost workers, the merged output
+// must be bit identical to the single process one
+int run_check_shards(const char *executable)
+{
+	// accumulations left by an earlier check would be resumed
+	static const char *files[] = { "check_shards.pfm", "check_shards.accum", "check_shards_merged.pfm",
+		"check_shards_merged.accum", "check_shards_part0.accum", "check_shards_part1.accum", "check_shards_part2.accum" };
+	for (const char *file : files)
+		remove(file);
+
+	// 3 x 2 tiles, two per shard
+	std::string command = std::string("\"") + executable + "\" --size 96x64 --tile 32 --iterations 8";
+	std::vector<std::string> commands = {
+		command + " -o check_shards.pfm --accum check_shards.accum",
+		command + " --accum check_shards_part0.accum --tiles 0 2",
+		command + " --accum check_shards_part1.accum --tiles 2 2 --time 0.000001",
 	};
-	
-	unsigned int VAO;
-	glGenVertexArrays(1, &VAO);
-	glBindVertexArray(VAO);
-	
-	unsigned int VBO;
-	glGenBuffers(1, &VBO);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-	unsigned int EBO;
-	glGenBuffers(1, &EBO);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-	
-	// positions
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_TRUE, 5 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);	
-	// texture coords
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_TRUE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-	glEnableVertexAttribArray(1);
-
-	unsigned int texture;
-	glGenTextures(1, &texture);
-	glBindTexture(GL_TEXTURE_2D, texture);
-
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-
-	float *f = new float[width * height];
-	for (int i = 0; i < width * height; i++)
+	std::vector<std::future<int>> processes;
+	for (const std::string &process : commands)
+		processes.push_back(std::async(std::launch::async, [process]() { return system(process.c_str()); }));
+	int failed = 0;
+	for (std::future<int> &process : processes)
+		failed += process.get() != 0;
+	if (failed == 0)
+		failed += system((command + " -o check_shards_merged.pfm --accum check_shards_merged.accum --merge check_shards_part0.accum"
+			" --merge check_shards_part1.accum --merge check_shards_part2.accum").c_str()) != 0;
+
+	bool same = failed == 0 && Checkpoint::HashFile("check_shards.pfm") == Checkpoint::HashFile("check_shards_merged.pfm");
+	std::cout << (same ? "merged shards are identical to the single process render"
+		: "merged shards DIFFER from the single process render, the files are kept") << std::endl;
+	if (same)
 	{
-		f[i] = sinf(i)*20;
+		for (const char *file : files)
+			remove(file);
 	}
-	// disable mipmaps
-	glTexStorage2D(GL_TEXTURE_2D, 1, GL_R32F, width, height);
-	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RED, GL_FLOAT, (float*)data);
-
-	//glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-	//glGenerateMipmap(GL_TEXTURE_2D);
-	stbi_image_free(data);
-
-	Shader shaderProgram("shader/ray.vert", "shader/ray.frag");
-	int uniform_WindowSize = shaderProgram.GetUniform("viewport_size");
-	int uniform_NoiseSize = shaderProgram.GetUniform("noise_size");
-	float rot = 0;
+	return same ? 0 : -1;
+}
 
-	shaderProgram.Use();
-	glUniform1i(shaderProgram.GetUniform("noise_map"), 0);
-	glUniform2ui(uniform_NoiseSize, width, height);
+// render a job with 1, 7 and 64 png encoder threads and compare hashes of the files,
+// the gpu render has no thread count so the encoder is where threads could change the output
+int run_check_threads(int argc, char * argv[])
+{
+	// large enough for several deflate chunks, quick enough for software drivers
+	RenderJob job;
+	job.width = 640;
+	job.height = 360;
+	job.iterations = 1;
+	job.quality = Quality::Draft;
+	job.output = "check_threads.png";
+	if (!BatchRenderer::ParseJob(argc - 2, argv + 2, job))
+	{
+		BatchRenderer::PrintUsage();
+		return -1;
+	}
+	Renderer renderer(job.width, job.height, job.scene.c_str(), job.quality);
+	BatchRenderer batch(renderer);
+
+	static const unsigned int thread_counts[] = { 1, 7, 64 };
+	unsigned long long hashes[3];
+	size_t extension = job.output.find_last_of('.');
+	std::string output = job.output;
+	for (int i = 0; i < 3; i++)
+	{
+		job.threads = thread_counts[i];
+		job.output = output;
+		job.output.insert(extension == std::string::npos ? job.output.size() : extension, "_" + std::to_string(job.threads));
+		if (!batch.Run(job))
+			return -1;
+		hashes[i] = Checkpoint::HashFile(job.output.c_str());
+		remove(job.output.c_str());
+		std::cout << job.output << " with " << job.threads << " threads hash " << std::hex << hashes[i] << std::dec << std::endl;
+	}
+	bool same = hashes[0] == hashes[1] && hashes[0] == hashes[2];
+	std::cout << (same ? "render is independent of the thread count" : "render DIFFERS between thread counts") << std::endl;
+	return same ? 0 : -1;
+}
 
-	glUniform1i(shaderProgram.GetUniform("frame_canvas"), 1);
-	glUniform1i(shaderProgram.GetUniform("iteration_count"), ITERATION);
+int run_interactive(GLFWwindow* window)
+{
+	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+	glfwSetCursorPosCallback(window, cursor_pos_callback);
+	glfwSetMouseButtonCallback(window, mouse_button_callback);
+	glfwSetKeyCallback(window, key_callback);
+	glfwSetWindowRefreshCallback(window, window_refresh_callback);
 
-	int uniform_LightPos = shaderProgram.GetUniform("light1.position");
-	int uniform_LightRad = shaderProgram.GetUniform("light1.radius");
-	int uniform_LightLum = shaderProgram.GetUniform("light1.luminance");
+	//glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
-	// light attributes
-	glUniform1f(uniform_LightRad, 0.04);
-	glUniform3f(uniform_LightLum, 8, 8, 8);
-	
-	//std::cout << shaderProgram.GetUniform("noise_map") << std::endl;
+	Renderer renderer(windowWidth, windowHeight);
 
 	Shader shaderProgram2("shader/screen.vert", "shader/screen.frag");
 
-	unsigned int FBO;
-	glGenFramebuffers(1, &FBO);
-	glBindFramebuffer(GL_FRAMEBUFFER, FBO);
-	glGenTextures(1, &colorBuffer);
-	glBindTexture(GL_TEXTURE_2D, colorBuffer);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, DEFAULT_WIDTH, DEFAULT_HEIGHT, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorBuffer, 0);
-	glBindTexture(GL_TEXTURE_2D, 0);
+	int uniform_Exposure = shaderProgram2.GetUniform("exposure");
+	int uniform_PreviewScale = shaderProgram2.GetUniform("preview_scale");
+	shaderProgram2.Use();
+	glUniform1f(uniform_Exposure, 1.f);
 
-	GLenum DrawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
-	glDrawBuffers(3, DrawBuffers);
+	FrameScheduler scheduler(FRAME_BUDGET);
 
-	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-		std::cout << "ERROR::FRAMEBUFFER:: Framebuffer is not complete!" << std::endl;
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	// resume the render of the last session, the light stays where it was until clicked
+	Checkpoint checkpoint(CHECKPOINT_FILE, Checkpoint::HashFile(NOISE_ASSET, renderer.GetSceneHash()));
+	float lightX, lightY;
+	if (checkpoint.Load(renderer, lightX, lightY))
+	{
+		// the checkpoint restores the render path it was taken on
+		computePath = renderer.IsComputePath();
+		cursorX = lightX;
+		cursorY = lightY;
+		sceneDirty = false;
+		editMode = false;
+		previewLevel = 0;
+	}
+	unsigned int checkpointIteration = renderer.GetIteration();
+	double checkpointTimer = 0;
 
 	int frameRate = 0;
+	int passRate = 0;
 	double timer = 0;
 
 	std::cout << glGetString(GL_VENDOR) << std::endl;
 	std::cout << "Start Rendering Loop" << std::endl;
-	iteration = 0;
 
 	while (!glfwWindowShouldClose(window))
 	{
 		//std::cout << glGetError() << std::endl;
 
 		auto startFrame = std::chrono::high_resolution_clock::now();
+		TRACE_SCOPE("frame");
 
 		if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
 			glfwSetWindowShouldClose(window, true);
 
-		// rendering
-		if (iteration < ITERATION)
+		// coalesce all input received since the last frame into one restart,
+		// this also cancels any preview level still pending
+		if (sceneDirty)
 		{
-			glBindFramebuffer(GL_FRAMEBUFFER, FBO);
-
-			glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-			//glClear(GL_COLOR_BUFFER_BIT);
-
-			glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_2D, texture);
-			glActiveTexture(GL_TEXTURE1);
-			glBindTexture(GL_TEXTURE_2D, colorBuffer);
+			TRACE_SCOPE("input");
+			if (renderer.GetWidth() != windowWidth || renderer.GetHeight() != windowHeight)
+			{
+				renderer.Resize(windowWidth, windowHeight);
+				scheduler.Reset();
+			}
+			if (computePath != renderer.IsComputePath())
+			{
+				computePath = renderer.SetComputePath(computePath) && computePath;
+				std::cout << (computePath ? "Compute" : "Fragment") << " shader accumulation" << std::endl;
+			}
+			renderer.Clear();
+			renderer.SetLight(cursorX, cursorY);
+			previewLevel = PREVIEW_LEVELS;
+			sceneDirty = false;
+			checkpointIteration = 0;
+			checkpointTimer = 0;
+		}
 
-			shaderProgram.Use();
-			glUniform2f(uniform_WindowSize, windowWidth, windowHeight);
-			glUniform2f(uniform_LightPos, cursorX, cursorY);
-			int a[16] = {};
-			for (int i = 0; i < 16; i++)
+		// rendering
+		scheduler.BeginFrame();
+		if (previewLevel > 0)
+		{
+			// previews are shown one level per frame
+			renderer.RenderPass(previewLevel--);
+			presentPending = true;
+		}
+		else
+		{
+			// fill the frame budget with as many accumulation passes as fit
+			while (!renderer.IsConverged() && scheduler.HasBudget())
 			{
-				a[i] = iteration * 16 + i;
+				scheduler.BeginPass();
+				renderer.RenderPass(0);
+				scheduler.EndPass();
+				presentPending = true;
 			}
-			
-			glUniform1iv(shaderProgram.GetUniform("rangle"), 16, a);
+			passRate += scheduler.GetFramePasses();
+		}
 
-			iteration++;
+		// only present when there is something new to show
+		if (presentPending)
+		{
+			{
+				TRACE_SCOPE("screen pass");
+				TRACE_GPU_SCOPE("screen pass");
+				glBindFramebuffer(GL_FRAMEBUFFER, 0);
+				glClearColor(1.f, 0.1f, 0.1f, 1.0f);
+				glClear(GL_COLOR_BUFFER_BIT);
+				shaderProgram2.Use();
+				glUniform1i(uniform_PreviewScale, 1 << renderer.GetDisplayLevel());
+				glActiveTexture(GL_TEXTURE0);
+				glBindTexture(GL_TEXTURE_2D, renderer.GetDisplayTexture());
+
+				renderer.DrawQuad();
+			}
 
-			glBindVertexArray(VAO);
-			//glDrawArrays(GL_TRIANGLES, 0, 3);
-			glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+			{
+				TRACE_SCOPE("swap");
+				glfwSwapBuffers(window);
+			}
+			presentPending = false;
+			frameRate++;
 		}
 
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
-		glClearColor(1.f, 0.1f, 0.1f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT);
-		shaderProgram2.Use();
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, colorBuffer);
-
-		glBindVertexArray(VAO);
-		glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+		// checkpoint unfinished renders periodically and finished ones once
+		checkpoint.Update();
+		bool converged = previewLevel == 0 && renderer.IsConverged() && !sceneDirty;
+		if (previewLevel == 0 && renderer.GetIteration() != checkpointIteration
+			&& (converged || checkpointTimer > CHECKPOINT_INTERVAL))
+		{
+			// a finished render must not miss its checkpoint because an earlier one is still writing
+			TRACE_SCOPE("checkpoint");
+			if (converged)
+				checkpoint.Wait();
+			if (checkpoint.Capture(renderer, (float)cursorX, (float)cursorY))
+			{
+				checkpointIteration = renderer.GetIteration();
+				checkpointTimer = 0;
+			}
+		}
 
-		glBindVertexArray(0);		
+		// block until the next input once the image has converged
+		if (converged)
+		{
+			// the readback must be handed to the writer before going idle
+			checkpoint.Update(true);
+			TRACE_SCOPE("idle");
+			glfwWaitEvents();
+		}
+		else
+		{
+			TRACE_SCOPE("input");
+			glfwPollEvents();
+		}
 
-		glfwSwapBuffers(window);
-		glfwPollEvents();		
+		// T starts tracing and the next T writes the trace, passes are only timed while tracing
+		if (traceRequested)
+		{
+			if (!Trace::IsEnabled())
+			{
+				Trace::Enable(true);
+				std::cout << "Tracing, press T again to write " << TRACE_FILE << std::endl;
+			}
+			else
+			{
+				Trace::Dump(TRACE_FILE);
+				Trace::Enable(false);
+			}
+			traceRequested = false;
+		}
 
 		auto endFrame = high_resolution_clock::now();
 		double deltaTime = duration_cast<duration<double>>(endFrame - startFrame).count();
-		frameRate++;
 
 		timer += deltaTime;
+		checkpointTimer += deltaTime;
 		if (timer > 1)
 		{
-			std::cout << frameRate  << std::endl;
+			std::cout << frameRate << " fps " << passRate << " passes" << std::endl;
 			timer = 0;
 			frameRate = 0;
+			passRate = 0;
 		}
 	}
 
-	glfwTerminate();
+	// keep the progress of an unfinished render, the destructor waits for the write
+	if (previewLevel == 0 && !sceneDirty && renderer.GetIteration() != checkpointIteration)
+	{
+		checkpoint.Wait();
+		checkpoint.Capture(renderer, (float)cursorX, (float)cursorY);
+	}
 	return 0;
+}
+
+int main(int argc, char * argv[])
+{	
+	//NoiseGenerator generator(42);
+	//generator.CreateFloatNoiseTexture("gray.png", 1024);
+
+	// --isa forces older cpu kernel variants, the remaining arguments are handled as usual
+	if (argc >= 3 && strcmp(argv[1], "--isa") == 0)
+	{
+		if (!CpuFeatures::SetIsa(argv[2]))
+			return -1;
+		argv[2] = argv[0];
+		argv += 2;
+		argc -= 2;
+	}
+	std::cout << "CPU kernels use " << CpuFeatures::GetIsaName(CpuFeatures::GetIsa()) << std::endl;
+
+	// asset conversion does not need a context
+	if (argc == 4 && strcmp(argv[1], "--convert-noise") == 0)
+	{
+		return NoiseAsset::ConvertPNG(argv[2], argv[3]) ? 0 : -1;
+	}
+	if ((argc == 2 || argc == 3) && strcmp(argv[1], "--create-noise") == 0)
+	{
+		const char *asset_file = argc == 3 ? argv[2] : NOISE_ASSET;
+		NoiseGenerator generator(NOISE_SEED);
+		unsigned int threads = std::thread::hardware_concurrency();
+		if (!generator.CreateFloatNoiseAsset(asset_file, NOISE_SIZE, threads > 0 ? threads : 1))
+			return -1;
+		std::cout << "Created " << asset_file << std::endl;
+		return 0;
+	}
+	if (argc == 2 && strcmp(argv[1], "--check-shards") == 0)
+	{
+		return run_check_shards(argv[0]);
+	}
+	if ((argc == 2 || argc == 3) && strcmp(argv[1], "--check-noise") == 0)
+	{
+		unsigned int size = argc == 3 ? (unsigned int)atoi(argv[2]) : 1024;
+		if (size == 0 || (size & (size - 1)) != 0)
+		{
+			std::cout << "noise size must be a power of 2" << std::endl;
+			return -1;
+		}
+		NoiseGenerator generator(NOISE_SEED);
+		return generator.CheckDeterminism(size) ? 0 : -1;
+	}
+
+	// any argument switches to offscreen batch rendering
+	bool batch = argc > 1;
+	
+	glfwInit();
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	if (batch)
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+	GLFWwindow* window = glfwCreateWindow(DEFAULT_WIDTH, DEFAULT_HEIGHT, "Light2D", NULL, NULL);
+	if (window == NULL)
+	{
+		std::cout << "Failed to create GLFW window" << std::endl;
+		glfwTerminate();
+		return -1;
+	}
+	glfwMakeContextCurrent(window);
+
+	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+	{
+		std::cout << "Failed to initialize GLAD" << std::endl;
+		return -1;
+	}
+
+	glViewport(0, 0, DEFAULT_WIDTH, DEFAULT_HEIGHT);
+	Trace::SetThreadName("main");
+
+	int result;
+	if (!batch)
+		result = run_interactive(window);
+	else if (strcmp(argv[1], "--bench") == 0)
+		result = run_bench(argc, argv);
+	else if (strcmp(argv[1], "--check-threads") == 0)
+		result = run_check_threads(argc, argv);
+	else
+		result = run_batch(argc, argv);
+
+	glfwTerminate();
+	return result;
 }
\ No newline at end of file
@@ -0,0 +1,128 @@
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "MappedFile.h"
+
+using namespace std;
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+bool MappedFile::Open(const char *file_name)
+{
+	return Map(file_name, 0, false);
+}
+
+bool MappedFile::Create(const char *file_name, size_t size)
+{
+	return Map(file_name, size, true);
+}
+
+bool MappedFile::Map(const char *file_name, size_t size, bool writable)
+{
+	Close();
+
+#ifdef _WIN32
+	file = CreateFileA(file_name, writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ, FILE_SHARE_READ, NULL,
+		writable ? OPEN_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		file = nullptr;
+		return false;
+	}
+	LARGE_INTEGER existing;
+	GetFileSizeEx(file, &existing);
+	created = existing.QuadPart == 0;
+	this->size = writable ? size : (size_t)existing.QuadPart;
+	// an empty file can not be mapped, the mapping extends a writable file to size
+	if (this->size > 0)
+	{
+		mapping = CreateFileMappingA(file, NULL, writable ? PAGE_READWRITE : PAGE_READONLY,
+			(DWORD)((unsigned long long)this->size >> 32), (DWORD)this->size, NULL);
+		if (mapping != nullptr)
+			view = (unsigned char *)MapViewOfFile(mapping, writable ? FILE_MAP_ALL_ACCESS : FILE_MAP_READ, 0, 0, 0);
+	}
+#else
+	file = open(file_name, writable ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+	if (file < 0)
+		return false;
+	struct stat existing;
+	fstat(file, &existing);
+	created = existing.st_size == 0;
+	this->size = writable ? size : (size_t)existing.st_size;
+	if (writable && (size_t)existing.st_size < size && ftruncate(file, size) != 0)
+	{
+		Close();
+		return false;
+	}
+	if (this->size > 0)
+	{
+		view = (unsigned char *)mmap(nullptr, this->size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, file, 0);
+		if (view == MAP_FAILED)
+			view = nullptr;
+	}
+#endif
+	if (view == nullptr)
+	{
+		cout << "failed to map " << file_name << endl;
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void MappedFile::Close()
+{
+#ifdef _WIN32
+	if (view != nullptr)
+		UnmapViewOfFile(view);
+	if (mapping != nullptr)
+		CloseHandle(mapping);
+	if (file != nullptr)
+		CloseHandle(file);
+	mapping = nullptr;
+	file = nullptr;
+#else
+	if (view != nullptr)
+		munmap(view, size);
+	if (file >= 0)
+		close(file);
+	file = -1;
+#endif
+	view = nullptr;
+	size = 0;
+}
+
+void MappedFile::Flush(void *data, size_t bytes)
+{
+	// flushing must start on a page boundary
+	size_t offset = (unsigned char *)data - view;
+	size_t begin = offset / 4096 * 4096;
+#ifdef _WIN32
+	FlushViewOfFile(view + begin, offset + bytes - begin);
+#else
+	msync(view + begin, offset + bytes - begin, MS_SYNC);
+#endif
+}
+
+void MappedFile::Release(void *data, size_t bytes)
+{
+#ifdef _WIN32
+	// unlocking pages that are not locked removes them from the working set
+	VirtualUnlock(data, bytes);
+#else
+	madvise(data, bytes, MADV_DONTNEED);
+#endif
+}
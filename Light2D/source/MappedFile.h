@@ -0,0 +1,44 @@
+#pragma once
+#include <stddef.h>
+
+// file mapped into memory, read only or shared read write
+class MappedFile
+{
+public:
+	MappedFile() { };
+	// remove copy constructor/assignment
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+	// unmaps and closes the file if still open
+	~MappedFile();
+
+	// map an existing file read only
+	bool Open(const char *file_name);
+	// map a file read write, creating it and growing it to size if needed,
+	// grown bytes read as zero
+	bool Create(const char *file_name, size_t size);
+	void Close();
+
+	unsigned char *GetData() const { return view; }
+	size_t GetSize() const { return size; }
+	// the file was empty or did not exist before Create
+	bool IsNew() const { return created; }
+
+	// write back a range of a writable mapping
+	void Flush(void *data, size_t bytes);
+	// drop a range from the working set, it is read back from disk if touched again
+	void Release(void *data, size_t bytes);
+
+private:
+#ifdef _WIN32
+	void *file = nullptr;
+	void *mapping = nullptr;
+#else
+	int file = -1;
+#endif
+	unsigned char *view = nullptr;
+	size_t size = 0;
+	bool created = false;
+
+	bool Map(const char *file_name, size_t size, bool writable);
+};
@@ -0,0 +1,66 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <iostream>
+
+#include "Metrics.h"
+#include "Platform.h"
+
+using namespace std;
+
+bool Metrics::LoadPFM(const char *image_file, int &width, int &height, vector<float> &rgb)
+{
+	FILE *stream = nullptr;
+	fopen_s(&stream, image_file, "rb");
+	if (stream == nullptr)
+	{
+		cout << "failed to open reference " << image_file << endl;
+		return false;
+	}
+
+	// negative scale is little endian, the only byte order written here
+	char type[3];
+	float scale = 0;
+	bool success = fread(type, 1, sizeof(type), stream) == sizeof(type) && memcmp(type, "PF\n", sizeof(type)) == 0
+		&& fscanf_s(stream, "%d %d %f", &width, &height, &scale) == 3 && width > 0 && height > 0 && scale < 0
+		&& fgetc(stream) == '\n';
+	if (success)
+	{
+		size_t size = (size_t)width * height * 3;
+		rgb.resize(size);
+		success = fread(rgb.data(), sizeof(float), size, stream) == size;
+	}
+	fclose(stream);
+	if (!success)
+		cout << "invalid reference " << image_file << ", expected a little endian rgb pfm" << endl;
+	return success;
+}
+
+ImageError Metrics::Compare(const float *rgb, const float *reference, size_t pixels, float exposure)
+{
+	double squared = 0, relative = 0, display = 0;
+	for (size_t i = 0; i < pixels; i++)
+	{
+		double distance = 0;
+		for (int c = 0; c < 3; c++)
+		{
+			double x = rgb[i * 3 + c], r = reference[i * 3 + c];
+			squared += (x - r) * (x - r);
+			relative += (x - r) * (x - r) / (r * r + RELMSE_EPSILON);
+			// same exponential tone mapping as screen.frag
+			double d = exp(-r * exposure) - exp(-x * exposure);
+			distance += d * d;
+		}
+		display += sqrt(distance / 3);
+	}
+	ImageError error;
+	error.rmse = sqrt(squared / (pixels * 3));
+	error.relmse = relative / (pixels * 3);
+	error.display = display / pixels;
+	return error;
+}
+
+double Metrics::Efficiency(const ImageError &error, double seconds)
+{
+	return error.relmse > 0 && seconds > 0 ? 1 / (error.relmse * seconds) : 0;
+}
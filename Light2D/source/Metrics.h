@@ -0,0 +1,25 @@
+#pragma once
+#include <vector>
+
+// offset of the relative mse denominator, keeps dark pixels from dominating
+#define RELMSE_EPSILON 0.01
+
+struct ImageError
+{
+	double rmse;
+	// mean of (x - r)^2 / (r^2 + RELMSE_EPSILON) over all channels
+	double relmse;
+	// mean colour distance after the display tone mapping, 0 to 1 like flip
+	double display;
+};
+
+// error of a render against a converged reference image
+class Metrics
+{
+public:
+	// read a pfm as written by ImageWriter, rgb rows bottom to top like gl
+	static bool LoadPFM(const char *image_file, int &width, int &height, std::vector<float> &rgb);
+	static ImageError Compare(const float *rgb, const float *reference, size_t pixels, float exposure = 1);
+	// 1 / (relmse * seconds), 0 when the error is not measurable
+	static double Efficiency(const ImageError &error, double seconds);
+};
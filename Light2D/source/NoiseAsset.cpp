@@ -0,0 +1,89 @@
+#include <stdio.h>
+#include <string.h>
+#include <iostream>
+
+#include "stb_image.h"
+
+#include "NoiseAsset.h"
+#include "Platform.h"
+
+using namespace std;
+
+bool NoiseAsset::Load(const char *asset_file)
+{
+	Close();
+	if (!file.Open(asset_file))
+		return false;
+
+	header = (const Header *)file.GetData();
+	if (file.GetSize() < sizeof(Header) || memcmp(header->magic, "L2DN", 4) != 0 || header->version != NOISE_ASSET_VERSION
+		|| (header->type != R32F && header->type != R32UI))
+	{
+		cout << asset_file << " is not a noise asset" << endl;
+		Close();
+		return false;
+	}
+	size_t count = (size_t)header->width * header->height;
+	if (file.GetSize() < sizeof(Header) + count * 4 || Checksum((const unsigned int *)GetData(), count) != header->checksum)
+	{
+		cout << asset_file << " is truncated or corrupt" << endl;
+		Close();
+		return false;
+	}
+	return true;
+}
+
+bool NoiseAsset::Save(const char *asset_file, unsigned int width, unsigned int height, Type type, const void *data)
+{
+	FILE *stream = nullptr;
+	fopen_s(&stream, asset_file, "wb");
+	if (stream == nullptr)
+	{
+		cout << "failed to open " << asset_file << endl;
+		return false;
+	}
+
+	size_t count = (size_t)width * height;
+	Header header;
+	memcpy(header.magic, "L2DN", 4);
+	header.version = NOISE_ASSET_VERSION;
+	header.width = width;
+	header.height = height;
+	header.type = type;
+	header.checksum = Checksum((const unsigned int *)data, count);
+
+	bool success = fwrite(&header, sizeof(Header), 1, stream) == 1 && fwrite(data, 4, count, stream) == count;
+	success = fclose(stream) == 0 && success;
+	if (!success)
+		cout << "failed to write " << asset_file << endl;
+	return success;
+}
+
+bool NoiseAsset::ConvertPNG(const char *png_file, const char *asset_file)
+{
+	// the png holds float bytes in 16 bit gray alpha samples, stb returns them in native order
+	int width, height, channels;
+	stbi_us *data = stbi_load_16(png_file, &width, &height, &channels, 2);
+	if (data == nullptr)
+	{
+		cout << "failed to load " << png_file << endl;
+		return false;
+	}
+	for (int i = 0; i < width * height * 2; i++)
+	{
+		data[i] = ((data[i] & 0xff) << 8) + ((data[i] & 0xff00) >> 8);
+	}
+	bool success = Save(asset_file, width, height, R32F, data);
+	stbi_image_free(data);
+	return success;
+}
+
+unsigned int NoiseAsset::Checksum(const unsigned int *words, size_t count)
+{
+	unsigned int hash = 2166136261u;
+	for (size_t i = 0; i < count; i++)
+	{
+		hash = (hash ^ words[i]) * 16777619u;
+	}
+	return hash;
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include "MappedFile.h"
+
+#define NOISE_ASSET_VERSION 1
+
+// binary noise and sample table asset, a small header followed by the raw texels
+// so the file can be memory mapped and handed to gl or read in place without decoding
+class NoiseAsset
+{
+public:
+	enum Type : unsigned int
+	{
+		R32F = 1, // one float per texel
+		R32UI = 2, // one unsigned int per texel
+	};
+
+	NoiseAsset() { };
+	// remove copy constructor/assignment
+	NoiseAsset(const NoiseAsset &) = delete;
+	NoiseAsset &operator=(const NoiseAsset &) = delete;
+
+	// map the asset and verify its header and checksum
+	bool Load(const char *asset_file);
+	void Close() { file.Close(); header = nullptr; }
+
+	unsigned int GetWidth() const { return header->width; }
+	unsigned int GetHeight() const { return header->height; }
+	Type GetType() const { return (Type)header->type; }
+	// texels in row order, valid until the asset is closed
+	const void *GetData() const { return header + 1; }
+
+	static bool Save(const char *asset_file, unsigned int width, unsigned int height, Type type, const void *data);
+	// convert a float noise png written by NoiseGenerator::CreateFloatNoiseTexture
+	static bool ConvertPNG(const char *png_file, const char *asset_file);
+
+private:
+	struct Header
+	{
+		char magic[4];
+		unsigned int version;
+		unsigned int width, height;
+		unsigned int type;
+		unsigned int checksum; // fnv-1a of the texel words
+	};
+
+	MappedFile file;
+	const Header *header = nullptr;
+
+	static unsigned int Checksum(const unsigned int *words, size_t count);
+};
@@ -1,25 +1,102 @@
 #include <assert.h>
-#include "svpng/svpng.inc"
+#include <iostream>
+#include <thread>
+#include <vector>
 
 #include "NoiseGenerator.h"
+#include "PngWriter.h"
+#include "NoiseAsset.h"
 
-void NoiseGenerator::CreateFloatNoiseTexture(const char *texture_name, unsigned int size)
+void NoiseGenerator::CreateFloatNoiseTexture(const char *texture_name, unsigned int size, unsigned int threads)
+{
+	std::vector<float> data = CreateFloatNoise(size, threads);
+
+	// create 16bit grayscale png with alpha holding the raw float bytes,
+	// each 16bit sample is stored big endian so the file bytes match memory order
+	const unsigned char *bytes = (const unsigned char *)data.data();
+	std::vector<unsigned short> samples(size * size * 2);
+	for (size_t i = 0; i < samples.size(); i++)
+	{
+		samples[i] = (unsigned short)(bytes[i * 2] << 8 | bytes[i * 2 + 1]);
+	}
+	PngWriter::Write(texture_name, size, size, 2, 16, samples.data(), threads);
+}
+
+bool NoiseGenerator::CreateFloatNoiseAsset(const char *asset_name, unsigned int size, unsigned int threads)
+{
+	std::vector<float> data = CreateFloatNoise(size, threads);
+	return NoiseAsset::Save(asset_name, size, size, NoiseAsset::R32F, data.data());
+}
+
+bool NoiseGenerator::CheckDeterminism(unsigned int size) const
+{
+	// odd and more than the hardware threads so rows are split unevenly and oversubscribed
+	static const unsigned int thread_counts[] = { 1, 7, 64 };
+	unsigned long long hashes[3];
+	for (int i = 0; i < 3; i++)
+	{
+		std::vector<float> data = CreateFloatNoise(size, thread_counts[i]);
+		// fnv-1a of the raw float bits
+		unsigned long long hash = 14695981039346656037ull;
+		const unsigned char *bytes = (const unsigned char *)data.data();
+		for (size_t b = 0; b < data.size() * sizeof(float); b++)
+		{
+			hash = (hash ^ bytes[b]) * 1099511628211ull;
+		}
+		hashes[i] = hash;
+		std::cout << size << " x " << size << " noise with " << thread_counts[i] << " threads hash "
+			<< std::hex << hash << std::dec << std::endl;
+	}
+	bool same = hashes[0] == hashes[1] && hashes[0] == hashes[2];
+	std::cout << (same ? "noise is independent of the thread count" : "noise DIFFERS between thread counts") << std::endl;
+	return same;
+}
+
+std::vector<float> NoiseGenerator::CreateFloatNoise(unsigned int size, unsigned int threads) const
 {
 	// size must be non-zero and power of 2
 	assert(size > 0 && ((size - 1) & size) == 0);
-	float *data = new float[size * size];
-	FILE* texture;
-	fopen_s(&texture, texture_name, "wb");
-	for (unsigned int i = 0; i < size * size; i++)
+	assert(threads > 0);
+	std::vector<float> data(size * size);
+	float *texels = data.data();
+
+	// rows are interleaved between threads, each texel only depends on its coordinates
+	std::vector<std::thread> workers;
+	for (unsigned int t = 0; t < threads; t++)
 	{
-		data[i] = RandomFloat01();
+		workers.emplace_back([=]()
+		{
+			for (unsigned int y = t; y < size; y += threads)
+			{
+				for (unsigned int x = 0; x < size; x++)
+				{
+					texels[y * size + x] = RandomFloat01(x, y, 0, 0);
+				}
+			}
+		});
 	}
-	// create 16bit grayscale png with alpha
-	svpng(texture, size, size, (unsigned char *)data, 1);
-	fclose(texture);
+	for (std::thread &worker : workers)
+	{
+		worker.join();
+	}
+	return data;
+}
+
+float NoiseGenerator::RandomFloat01(unsigned int x, unsigned int y, unsigned int sample, unsigned int dimension) const
+{
+	// chain the key through the hash so that neighbouring keys decorrelate
+	unsigned int h = Hash(seed ^ Hash(x ^ Hash(y ^ Hash(sample ^ Hash(dimension)))));
+	// keep 24 bits so the result is exactly representable and strictly below 1
+	return (h >> 8) * (1.f / 16777216.f);
 }
 
-float NoiseGenerator::RandomFloat01()
+unsigned int NoiseGenerator::Hash(unsigned int v)
 {
-	return rng() / (float)rng.max();
+	// integer finalizer with low bias (lowbias32)
+	v ^= v >> 16;
+	v *= 0x7feb352du;
+	v ^= v >> 15;
+	v *= 0x846ca68bu;
+	v ^= v >> 16;
+	return v;
 }
@@ -1,14 +1,27 @@
 #pragma once
-#include <random>
+#include <vector>
 
+// counter-based generator, every value is a pure function of (seed, key) so results
+// do not depend on generation order or on how many threads produced them
 class NoiseGenerator
 {
 public:
-	NoiseGenerator(unsigned int seed) : rng(seed) { };
-	void CreateFloatNoiseTexture(const char *texture_name, unsigned int size);
+	NoiseGenerator(unsigned int seed) : seed(seed) { };
+	void CreateFloatNoiseTexture(const char *texture_name, unsigned int size, unsigned int threads = 1);
+	// same noise written as a binary asset that loads without decoding
+	bool CreateFloatNoiseAsset(const char *asset_name, unsigned int size, unsigned int threads = 1);
+
+	// generate the noise with 1, 7 and 64 threads and compare hashes of the results,
+	// false if the thread count changed any value
+	bool CheckDeterminism(unsigned int size) const;
+
+	// uniform float in [0, 1), dimension selects an independent stream for the same sample
+	float RandomFloat01(unsigned int x, unsigned int y, unsigned int sample, unsigned int dimension) const;
 
 private:
-	std::mt19937 rng;
+	unsigned int seed;
+
+	std::vector<float> CreateFloatNoise(unsigned int size, unsigned int threads) const;
 
-	float RandomFloat01();
-};
\ No newline at end of file
+	static unsigned int Hash(unsigned int v);
+};
@@ -0,0 +1,95 @@
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#include <errno.h>
+#include <string.h>
+#include <iostream>
+
+#include "PerfCounters.h"
+
+using namespace std;
+
+PerfSample PerfSample::operator-(const PerfSample &start) const
+{
+	PerfSample delta;
+	for (int i = 0; i < PERF_COUNTERS; i++)
+	{
+		delta.values[i] = values[i] - start.values[i];
+	}
+	return delta;
+}
+
+#ifdef __linux__
+// indexed by PerfCounter
+static const unsigned long long perf_configs[PERF_COUNTERS] = {
+	PERF_COUNT_HW_CPU_CYCLES,
+	PERF_COUNT_HW_INSTRUCTIONS,
+	PERF_COUNT_HW_CACHE_REFERENCES,
+	PERF_COUNT_HW_CACHE_MISSES,
+	PERF_COUNT_HW_BRANCH_INSTRUCTIONS,
+	PERF_COUNT_HW_BRANCH_MISSES,
+};
+
+PerfCounters::PerfCounters()
+{
+	for (int i = 0; i < PERF_COUNTERS; i++)
+	{
+		// separate counters instead of a group, groups can not be read with inherit set
+		perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = perf_configs[i];
+		attr.inherit = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+		fds[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+		available = available || fds[i] >= 0;
+	}
+	// no such event without a pmu, e.g. in most virtual machines, denied by perf_event_paranoid
+	if (!available)
+		cout << "hardware counters are not available: " << strerror(errno) << endl;
+}
+
+PerfCounters::~PerfCounters()
+{
+	for (int fd : fds)
+	{
+		if (fd >= 0)
+			close(fd);
+	}
+}
+
+PerfSample PerfCounters::Read() const
+{
+	PerfSample sample = {};
+	for (int i = 0; i < PERF_COUNTERS; i++)
+	{
+		// value, time enabled, time running
+		unsigned long long data[3];
+		if (fds[i] < 0 || read(fds[i], data, sizeof(data)) != sizeof(data) || data[2] == 0)
+			continue;
+		sample.values[i] = (unsigned long long)((double)data[0] * data[1] / data[2]);
+	}
+	return sample;
+}
+#else
+PerfCounters::PerfCounters()
+{
+	for (int &fd : fds)
+		fd = -1;
+	cout << "hardware counters are only read on linux" << endl;
+}
+
+PerfCounters::~PerfCounters()
+{
+}
+
+PerfSample PerfCounters::Read() const
+{
+	return PerfSample();
+}
+#endif
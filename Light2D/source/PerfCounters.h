@@ -0,0 +1,41 @@
+#pragma once
+
+// hardware events counted per phase, in PerfCounter order
+enum class PerfCounter
+{
+	Cycles,
+	Instructions,
+	CacheReferences,
+	CacheMisses,
+	Branches,
+	BranchMisses,
+};
+#define PERF_COUNTERS 6
+
+struct PerfSample
+{
+	// scaled up when the kernel multiplexed a counter, 0 when it could not be opened
+	unsigned long long values[PERF_COUNTERS];
+
+	unsigned long long Get(PerfCounter counter) const { return values[(int)counter]; }
+	PerfSample operator-(const PerfSample &start) const;
+};
+
+// cpu hardware counters of the calling thread and the threads it starts afterwards,
+// read through perf_event_open on linux and unavailable elsewhere. inherited counters
+// can only be read as one total, so worker threads are summed into the calling thread
+// rather than reported per thread
+class PerfCounters
+{
+public:
+	PerfCounters();
+	~PerfCounters();
+
+	// false when no counter could be opened, e.g. without perf permissions or off linux
+	bool IsAvailable() const { return available; }
+	PerfSample Read() const;
+
+private:
+	int fds[PERF_COUNTERS];
+	bool available = false;
+};
@@ -0,0 +1,25 @@
+#pragma once
+#include <stdio.h>
+#include <time.h>
+
+// the sources use the msvc crt, elsewhere its functions map onto their posix equivalents
+#ifndef _MSC_VER
+#include <errno.h>
+#include <strings.h>
+
+#define _stricmp strcasecmp
+// only called with numeric conversions, which take no buffer sizes
+#define sscanf_s sscanf
+#define fscanf_s fscanf
+
+inline int fopen_s(FILE **stream, const char *file, const char *mode)
+{
+	*stream = fopen(file, mode);
+	return *stream != nullptr ? 0 : errno;
+}
+
+inline int localtime_s(tm *local, const time_t *time)
+{
+	return localtime_r(time, local) != nullptr ? 0 : errno;
+}
+#endif
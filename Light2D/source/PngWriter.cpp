@@ -0,0 +1,750 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <iostream>
+#include <thread>
+
+#include "PngWriter.h"
+#include "CpuFeatures.h"
+#include "Trace.h"
+#include "Platform.h"
+
+#define CHUNK_SIZE (256 * 1024) // filtered bytes per parallel deflate chunk
+#define WINDOW_SIZE 32768
+#define HASH_BITS 15
+#define MAX_CHAIN 8 // candidates examined per position, trades speed for ratio
+#define GOOD_MATCH 32 // stop searching the chain once a match is this long
+#define MIN_MATCH 3
+#define MAX_MATCH 258
+#define BLOCK_SYMBOLS 65536 // lz77 symbols per huffman block
+#define MAX_CODE_BITS 15
+#define MAX_CLEN_BITS 7
+
+using namespace std;
+
+static const unsigned short length_base[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59,
+	67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const unsigned char length_extra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+	4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const unsigned short dist_base[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385,
+	513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const unsigned char dist_extra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7,
+	8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+static const unsigned char clen_order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+// lsb first bit packing as required by deflate
+struct BitWriter
+{
+	vector<unsigned char> &out;
+	unsigned long long bits = 0;
+	int count = 0;
+
+	BitWriter(vector<unsigned char> &out) : out(out) { };
+
+	void Put(unsigned int value, int n)
+	{
+		bits |= (unsigned long long)value << count;
+		count += n;
+		while (count >= 8)
+		{
+			out.push_back((unsigned char)bits);
+			bits >>= 8;
+			count -= 8;
+		}
+	}
+
+	void Align()
+	{
+		if (count > 0)
+			Put(0, 8 - count);
+	}
+};
+
+// symbol lookup for lengths 0-258 and distances, distances above 256 are indexed by (dist - 1) >> 7
+struct CodeTables
+{
+	unsigned char length[MAX_MATCH + 1];
+	unsigned char dist[512];
+
+	CodeTables()
+	{
+		for (int code = 0, l = 0; l <= MAX_MATCH; l++)
+		{
+			while (code < 28 && length_base[code + 1] <= l)
+				code++;
+			length[l] = (unsigned char)code;
+		}
+		for (int code = 0, d = 1; d <= 256; d++)
+		{
+			while (code < 29 && dist_base[code + 1] <= d)
+				code++;
+			dist[d - 1] = (unsigned char)code;
+		}
+		for (int code = 0, i = 2; i < 256; i++)
+		{
+			int d = (i << 7) + 1;
+			while (code < 29 && dist_base[code + 1] <= d)
+				code++;
+			dist[256 + i] = (unsigned char)code;
+		}
+	}
+};
+
+static const CodeTables code_tables;
+
+static int length_code(int length)
+{
+	return code_tables.length[length];
+}
+
+static int dist_code(int dist)
+{
+	return dist <= 256 ? code_tables.dist[dist - 1] : code_tables.dist[256 + ((dist - 1) >> 7)];
+}
+
+// length limited huffman code lengths from symbol frequencies
+static void build_lengths(const unsigned int *freq, int n, int max_bits, unsigned char *lengths)
+{
+	vector<int> symbols;
+	for (int i = 0; i < n; i++)
+	{
+		lengths[i] = 0;
+		if (freq[i] > 0)
+			symbols.push_back(i);
+	}
+	// a valid code needs at least two symbols
+	for (int i = 0; symbols.size() < 2; i++)
+	{
+		if (freq[i] == 0)
+			symbols.push_back(i);
+	}
+	auto weight = [&](int s) { return max(freq[s], 1u); };
+	sort(symbols.begin(), symbols.end(), [&](int a, int b) { return weight(a) < weight(b); });
+
+	// two queue huffman construction over leaves sorted by weight
+	size_t leaves = symbols.size();
+	vector<unsigned long long> node_weight(leaves * 2);
+	vector<int> parent(leaves * 2, -1);
+	for (size_t i = 0; i < leaves; i++)
+		node_weight[i] = weight(symbols[i]);
+	size_t next_leaf = 0, next_node = leaves, nodes = leaves;
+	auto take = [&]()
+	{
+		if (next_leaf < leaves && (next_node >= nodes || node_weight[next_leaf] <= node_weight[next_node]))
+			return next_leaf++;
+		return next_node++;
+	};
+	while (nodes < leaves * 2 - 1)
+	{
+		size_t a = take();
+		size_t b = take();
+		node_weight[nodes] = node_weight[a] + node_weight[b];
+		parent[a] = parent[b] = (int)nodes;
+		nodes++;
+	}
+
+	int depth_count[64] = {};
+	vector<int> depth(nodes, 0);
+	for (size_t i = nodes - 1; i-- > 0;)
+		depth[i] = depth[parent[i]] + 1;
+	for (size_t i = 0; i < leaves; i++)
+		depth_count[min(depth[i], 63)]++;
+
+	// fold codes deeper than max_bits back until the kraft sum is exact again
+	for (int i = max_bits + 1; i < 64; i++)
+	{
+		depth_count[max_bits] += depth_count[i];
+		depth_count[i] = 0;
+	}
+	unsigned int total = 0;
+	for (int i = max_bits; i > 0; i--)
+		total += depth_count[i] << (max_bits - i);
+	while (total != (1u << max_bits))
+	{
+		depth_count[max_bits]--;
+		for (int i = max_bits - 1; i > 0; i--)
+		{
+			if (depth_count[i])
+			{
+				depth_count[i]--;
+				depth_count[i + 1] += 2;
+				break;
+			}
+		}
+		total--;
+	}
+
+	// rarest symbols get the longest codes
+	size_t s = 0;
+	for (int bits = max_bits; bits > 0; bits--)
+	{
+		for (int i = 0; i < depth_count[bits]; i++)
+			lengths[symbols[s++]] = (unsigned char)bits;
+	}
+}
+
+// canonical huffman codes, bit reversed for lsb first output
+static void build_codes(const unsigned char *lengths, int n, unsigned short *codes)
+{
+	int bl_count[MAX_CODE_BITS + 1] = {};
+	unsigned int next_code[MAX_CODE_BITS + 1] = {};
+	for (int i = 0; i < n; i++)
+		bl_count[lengths[i]]++;
+	bl_count[0] = 0;
+	unsigned int code = 0;
+	for (int bits = 1; bits <= MAX_CODE_BITS; bits++)
+	{
+		code = (code + bl_count[bits - 1]) << 1;
+		next_code[bits] = code;
+	}
+	for (int i = 0; i < n; i++)
+	{
+		int len = lengths[i];
+		if (len == 0)
+			continue;
+		unsigned int c = next_code[len]++;
+		unsigned int reversed = 0;
+		for (int b = 0; b < len; b++)
+			reversed |= ((c >> b) & 1) << (len - 1 - b);
+		codes[i] = (unsigned short)reversed;
+	}
+}
+
+static inline int paeth(int a, int b, int c)
+{
+	int p = a + b - c;
+	int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+	return pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+}
+
+// symbols are literals (< 256) or (length << 16 | distance) matches
+static void write_block(BitWriter &writer, const unsigned int *symbols, size_t n, bool final)
+{
+	unsigned int lit_freq[286] = {}, dist_freq[30] = {};
+	for (size_t i = 0; i < n; i++)
+	{
+		unsigned int s = symbols[i];
+		if (s < 256)
+		{
+			lit_freq[s]++;
+		}
+		else
+		{
+			lit_freq[257 + length_code(s >> 16)]++;
+			dist_freq[dist_code(s & 0xffff)]++;
+		}
+	}
+	lit_freq[256]++;
+
+	unsigned char lit_len[286], dist_len[30];
+	build_lengths(lit_freq, 286, MAX_CODE_BITS, lit_len);
+	build_lengths(dist_freq, 30, MAX_CODE_BITS, dist_len);
+	int nlit = 286, ndist = 30;
+	while (nlit > 257 && lit_len[nlit - 1] == 0)
+		nlit--;
+	while (ndist > 1 && dist_len[ndist - 1] == 0)
+		ndist--;
+
+	// run length encode the code lengths of both trees as one sequence
+	unsigned char all_len[286 + 30];
+	memcpy(all_len, lit_len, nlit);
+	memcpy(all_len + nlit, dist_len, ndist);
+	int total = nlit + ndist;
+	vector<unsigned short> rle; // symbol | extra value << 8
+	unsigned int clen_freq[19] = {};
+	for (int i = 0; i < total;)
+	{
+		int len = all_len[i];
+		int run = 1;
+		while (i + run < total && all_len[i + run] == len)
+			run++;
+		i += run;
+		if (len == 0)
+		{
+			while (run >= 11)
+			{
+				int r = min(run, 138);
+				rle.push_back((unsigned short)(18 | (r - 11) << 8));
+				run -= r;
+			}
+			if (run >= 3)
+			{
+				rle.push_back((unsigned short)(17 | (run - 3) << 8));
+				run = 0;
+			}
+		}
+		else
+		{
+			rle.push_back((unsigned short)len);
+			run--;
+			while (run >= 3)
+			{
+				int r = min(run, 6);
+				rle.push_back((unsigned short)(16 | (r - 3) << 8));
+				run -= r;
+			}
+		}
+		while (run-- > 0)
+			rle.push_back((unsigned short)len);
+	}
+	for (unsigned short r : rle)
+		clen_freq[r & 0xff]++;
+
+	unsigned char clen_len[19];
+	build_lengths(clen_freq, 19, MAX_CLEN_BITS, clen_len);
+	int nclen = 19;
+	while (nclen > 4 && clen_len[clen_order[nclen - 1]] == 0)
+		nclen--;
+
+	unsigned short lit_code[286] = {}, dist_code_bits[30] = {}, clen_code[19] = {};
+	build_codes(lit_len, 286, lit_code);
+	build_codes(dist_len, 30, dist_code_bits);
+	build_codes(clen_len, 19, clen_code);
+
+	// dynamic huffman block header
+	writer.Put(final ? 1 : 0, 1);
+	writer.Put(2, 2);
+	writer.Put(nlit - 257, 5);
+	writer.Put(ndist - 1, 5);
+	writer.Put(nclen - 4, 4);
+	for (int i = 0; i < nclen; i++)
+		writer.Put(clen_len[clen_order[i]], 3);
+	for (unsigned short r : rle)
+	{
+		int s = r & 0xff;
+		writer.Put(clen_code[s], clen_len[s]);
+		if (s == 16)
+			writer.Put(r >> 8, 2);
+		else if (s == 17)
+			writer.Put(r >> 8, 3);
+		else if (s == 18)
+			writer.Put(r >> 8, 7);
+	}
+
+	for (size_t i = 0; i < n; i++)
+	{
+		unsigned int s = symbols[i];
+		if (s < 256)
+		{
+			writer.Put(lit_code[s], lit_len[s]);
+			continue;
+		}
+		int length = s >> 16, dist = s & 0xffff;
+		int lc = length_code(length), dc = dist_code(dist);
+		writer.Put(lit_code[257 + lc], lit_len[257 + lc]);
+		writer.Put(length - length_base[lc], length_extra[lc]);
+		writer.Put(dist_code_bits[dc], dist_len[dc]);
+		writer.Put(dist - dist_base[dc], dist_extra[dc]);
+	}
+	writer.Put(lit_code[256], lit_len[256]);
+}
+
+PngWriter::PngWriter(unsigned int threads)
+{
+	this->threads = threads > 0 ? threads : max(thread::hardware_concurrency(), 1u);
+}
+
+PngWriter::~PngWriter()
+{
+	if (stream != nullptr)
+		Close();
+}
+
+bool PngWriter::Open(const char *png_file, unsigned int width, unsigned int height, int channels, int bit_depth)
+{
+	assert(stream == nullptr);
+	assert(channels >= 1 && channels <= 4);
+	assert(bit_depth == 8 || bit_depth == 16);
+
+	fopen_s(&stream, png_file, "wb");
+	if (stream == nullptr)
+	{
+		cout << "failed to open png " << png_file << endl;
+		return false;
+	}
+	this->width = width;
+	this->height = height;
+	this->channels = channels;
+	this->bit_depth = bit_depth;
+	rows_written = 0;
+	above.assign(RowSize(), 0);
+	pending.clear();
+	pending_begin = 0;
+	adler = 1;
+
+	static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	fwrite(signature, 1, sizeof(signature), stream);
+
+	// gray, gray alpha, rgb, rgba
+	static const unsigned char color_type[4] = { 0, 4, 2, 6 };
+	unsigned char header[13] = {
+		(unsigned char)(width >> 24), (unsigned char)(width >> 16), (unsigned char)(width >> 8), (unsigned char)width,
+		(unsigned char)(height >> 24), (unsigned char)(height >> 16), (unsigned char)(height >> 8), (unsigned char)height,
+		(unsigned char)bit_depth, color_type[channels - 1], 0, 0, 0
+	};
+	WriteChunk(stream, "IHDR", header, sizeof(header));
+
+	// zlib stream split over idat chunks: header, one chunk per deflate chunk, adler32 trailer
+	static const unsigned char zlib_header[2] = { 0x78, 0x9c };
+	WriteChunk(stream, "IDAT", zlib_header, sizeof(zlib_header));
+	return true;
+}
+
+void PngWriter::WriteRows(const void *pixels, unsigned int rows)
+{
+	assert(stream != nullptr && rows_written + rows <= height);
+	TRACE_SCOPE("filter");
+	size_t row_size = RowSize();
+	size_t pitch = row_size + 1;
+
+	// filter rows in parallel, each row only needs the unfiltered row above it
+	size_t offset = pending.size();
+	pending.resize(offset + pitch * rows);
+	unsigned int rows_per_thread = (rows + threads - 1) / threads;
+	vector<thread> workers;
+	for (unsigned int t = 0; t < threads; t++)
+	{
+		unsigned int first = t * rows_per_thread;
+		unsigned int last = min(first + rows_per_thread, rows);
+		if (first >= last)
+			break;
+		workers.emplace_back(FilterRows, pixels, width, channels, bit_depth, first, last, above.data(),
+			pending.data() + offset + first * pitch);
+	}
+	for (thread &worker : workers)
+		worker.join();
+	rows_written += rows;
+
+	// remember the last row in png byte order for the next call
+	if (rows > 0)
+	{
+		if (bit_depth == 8)
+		{
+			memcpy(above.data(), (const unsigned char *)pixels + (size_t)(rows - 1) * row_size, row_size);
+		}
+		else
+		{
+			const unsigned short *src = (const unsigned short *)pixels + (size_t)(rows - 1) * width * channels;
+			for (size_t i = 0; i < row_size / 2; i++)
+			{
+				above[i * 2] = (unsigned char)(src[i] >> 8);
+				above[i * 2 + 1] = (unsigned char)src[i];
+			}
+		}
+	}
+
+	while (pending.size() - pending_begin >= CHUNK_SIZE)
+		Submit(CHUNK_SIZE, false);
+
+	// drop submitted data except for the window still needed as history
+	size_t history = min(pending_begin, (size_t)WINDOW_SIZE);
+	pending.erase(pending.begin(), pending.begin() + (pending_begin - history));
+	pending_begin = history;
+}
+
+bool PngWriter::Close()
+{
+	assert(stream != nullptr);
+	if (rows_written != height)
+		cout << "png closed after " << rows_written << " of " << height << " rows" << endl;
+
+	Submit(pending.size() - pending_begin, true);
+	Flush(0);
+
+	unsigned char trailer[4] = { (unsigned char)(adler >> 24), (unsigned char)(adler >> 16), (unsigned char)(adler >> 8), (unsigned char)adler };
+	WriteChunk(stream, "IDAT", trailer, sizeof(trailer));
+	WriteChunk(stream, "IEND", nullptr, 0);
+
+	bool success = ferror(stream) == 0 && rows_written == height;
+	fclose(stream);
+	stream = nullptr;
+	pending.clear();
+	return success;
+}
+
+bool PngWriter::Write(const char *png_file, unsigned int width, unsigned int height, int channels, int bit_depth,
+	const void *pixels, unsigned int threads)
+{
+	PngWriter writer(threads);
+	if (!writer.Open(png_file, width, height, channels, bit_depth))
+		return false;
+	writer.WriteRows(pixels, height);
+	return writer.Close();
+}
+
+void PngWriter::Submit(size_t count, bool final)
+{
+	// prefix the chunk with the preceding window so matches can reach back into it
+	size_t history = min(pending_begin, (size_t)WINDOW_SIZE);
+	unique_ptr<Chunk> chunk(new Chunk());
+	chunk->input.assign(pending.begin() + (pending_begin - history), pending.begin() + (pending_begin + count));
+	chunk->begin = history;
+	pending_begin += count;
+
+	Chunk *c = chunk.get();
+	c->done = async(launch::async, [c, final]()
+	{
+		Trace::SetThreadName("deflate");
+		TRACE_SCOPE("deflate");
+		Deflate(c->input.data(), c->begin, c->input.size(), final, c->output);
+		c->adler = Adler32(c->input.data() + c->begin, c->input.size() - c->begin);
+	});
+	chunks.push_back(move(chunk));
+
+	Flush(threads);
+}
+
+void PngWriter::Flush(size_t max_in_flight)
+{
+	while (!chunks.empty())
+	{
+		Chunk &chunk = *chunks.front();
+		bool ready = chunk.done.wait_for(chrono::seconds(0)) == future_status::ready;
+		if (!ready && chunks.size() <= max_in_flight)
+			break;
+		chunk.done.wait();
+
+		WriteChunk(stream, "IDAT", chunk.output.data(), chunk.output.size());
+		adler = Adler32Combine(adler, chunk.adler, chunk.input.size() - chunk.begin);
+		chunks.pop_front();
+	}
+}
+
+void PngWriter::FilterRows(const void *pixels, unsigned int width, int channels, int bit_depth,
+	unsigned int first_row, unsigned int last_row, const unsigned char *above, unsigned char *filtered)
+{
+	int bpp = channels * (bit_depth / 8);
+	size_t row_size = (size_t)width * bpp;
+	Bytes prev(row_size, 0), curr(row_size);
+
+	// png samples are big endian
+	auto load_row = [&](unsigned int y, Bytes &row)
+	{
+		if (bit_depth == 8)
+		{
+			memcpy(row.data(), (const unsigned char *)pixels + y * row_size, row_size);
+			return;
+		}
+		const unsigned short *src = (const unsigned short *)pixels + (size_t)y * width * channels;
+		for (size_t i = 0; i < row_size / 2; i++)
+		{
+			row[i * 2] = (unsigned char)(src[i] >> 8);
+			row[i * 2 + 1] = (unsigned char)src[i];
+		}
+	};
+
+	if (first_row > 0)
+		load_row(first_row - 1, prev);
+	else
+		memcpy(prev.data(), above, row_size);
+
+	for (unsigned int y = first_row; y < last_row; y++)
+	{
+		load_row(y, curr);
+		unsigned char *out = filtered + (y - first_row) * (row_size + 1);
+
+		// estimate every filter in one pass, then encode only the cheapest one
+		unsigned int cost[5] = {};
+		for (size_t i = 0; i < row_size; i++)
+		{
+			int a = i >= (size_t)bpp ? curr[i - bpp] : 0;
+			int b = prev[i];
+			int c = i >= (size_t)bpp ? prev[i - bpp] : 0;
+			int x = curr[i];
+			cost[0] += abs((signed char)x);
+			cost[1] += abs((signed char)(x - a));
+			cost[2] += abs((signed char)(x - b));
+			cost[3] += abs((signed char)(x - ((a + b) >> 1)));
+			cost[4] += abs((signed char)(x - paeth(a, b, c)));
+		}
+		int filter = (int)(min_element(cost, cost + 5) - cost);
+
+		out[0] = (unsigned char)filter;
+		for (size_t i = 0; i < row_size; i++)
+		{
+			int a = i >= (size_t)bpp ? curr[i - bpp] : 0;
+			int b = prev[i];
+			int c = i >= (size_t)bpp ? prev[i - bpp] : 0;
+			int predictor = 0;
+			switch (filter)
+			{
+			case 1: predictor = a; break;
+			case 2: predictor = b; break;
+			case 3: predictor = (a + b) >> 1; break;
+			case 4: predictor = paeth(a, b, c); break;
+			}
+			out[i + 1] = (unsigned char)(curr[i] - predictor);
+		}
+		swap(prev, curr);
+	}
+}
+
+void PngWriter::Deflate(const unsigned char *data, size_t begin, size_t end, bool final, Bytes &out)
+{
+	// the window before begin only primes the hash chains, its bytes are emitted by the previous chunk
+	size_t window_start = begin > WINDOW_SIZE ? begin - WINDOW_SIZE : 0;
+	vector<int> head(1 << HASH_BITS, -1);
+	vector<int> prev(end - window_start, -1);
+	auto hash = [&](size_t p)
+	{
+		return ((data[p] << 10) ^ (data[p + 1] << 5) ^ data[p + 2]) & ((1 << HASH_BITS) - 1);
+	};
+	auto insert = [&](size_t p)
+	{
+		if (p + MIN_MATCH > end)
+			return;
+		int h = hash(p);
+		prev[p - window_start] = head[h];
+		head[h] = (int)p;
+	};
+	for (size_t p = window_start; p < begin; p++)
+		insert(p);
+
+	vector<unsigned int> symbols;
+	symbols.reserve(end - begin);
+	for (size_t p = begin; p < end;)
+	{
+		int best_length = 0, best_dist = 0;
+		if (p + MIN_MATCH <= end)
+		{
+			size_t max_length = min((size_t)MAX_MATCH, end - p);
+			int candidate = head[hash(p)];
+			for (int chain = MAX_CHAIN; candidate >= 0 && chain > 0; chain--)
+			{
+				size_t dist = p - candidate;
+				if (dist > WINDOW_SIZE)
+					break;
+				const unsigned char *a = data + p, *b = data + candidate;
+				if (b[best_length] == a[best_length])
+				{
+					size_t length = 0;
+					while (length < max_length && a[length] == b[length])
+						length++;
+					if ((int)length > best_length)
+					{
+						best_length = (int)length;
+						best_dist = (int)dist;
+						if (length == max_length || length >= GOOD_MATCH)
+							break;
+					}
+				}
+				candidate = prev[candidate - window_start];
+			}
+		}
+
+		if (best_length >= MIN_MATCH)
+		{
+			symbols.push_back((unsigned int)best_length << 16 | best_dist);
+			for (int i = 0; i < best_length; i++)
+				insert(p + i);
+			p += best_length;
+		}
+		else
+		{
+			symbols.push_back(data[p]);
+			insert(p);
+			p++;
+		}
+	}
+
+	BitWriter writer(out);
+	out.reserve(end - begin);
+	size_t blocks = max((symbols.size() + BLOCK_SYMBOLS - 1) / BLOCK_SYMBOLS, (size_t)1);
+	for (size_t b = 0; b < blocks; b++)
+	{
+		size_t first = b * BLOCK_SYMBOLS;
+		size_t count = min((size_t)BLOCK_SYMBOLS, symbols.size() - first);
+		write_block(writer, symbols.data() + first, count, final && b + 1 == blocks);
+	}
+	if (!final)
+	{
+		// empty stored block ends the chunk on a byte boundary so chunks can be concatenated
+		writer.Put(0, 3);
+		writer.Align();
+		writer.Put(0x0000, 16);
+		writer.Put(0xffff, 16);
+	}
+	writer.Align();
+}
+
+unsigned int PngWriter::Adler32(const unsigned char *data, size_t size)
+{
+	switch (CpuFeatures::GetIsa())
+	{
+	case Isa::AVX512:
+		return Adler32AVX512(data, size, 1);
+	case Isa::AVX2:
+		return Adler32AVX2(data, size, 1);
+	case Isa::SSE42:
+		return Adler32SSE42(data, size, 1);
+	default:
+		return Adler32Scalar(data, size, 1);
+	}
+}
+
+unsigned int PngWriter::Adler32Scalar(const unsigned char *data, size_t size, unsigned int adler)
+{
+	unsigned int a = adler & 0xffff, b = adler >> 16;
+	while (size > 0)
+	{
+		size_t n = min(size, (size_t)ADLER_BLOCK);
+		for (size_t i = 0; i < n; i++)
+		{
+			a += data[i];
+			b += a;
+		}
+		a %= ADLER_BASE;
+		b %= ADLER_BASE;
+		data += n;
+		size -= n;
+	}
+	return b << 16 | a;
+}
+
+unsigned int PngWriter::Adler32Combine(unsigned int adler1, unsigned int adler2, size_t size2)
+{
+	const unsigned int base = 65521;
+	unsigned int rem = (unsigned int)(size2 % base);
+	unsigned int sum1 = adler1 & 0xffff;
+	unsigned int sum2 = (unsigned int)(((unsigned long long)rem * sum1) % base);
+	sum1 += (adler2 & 0xffff) + base - 1;
+	sum2 += ((adler1 >> 16) & 0xffff) + ((adler2 >> 16) & 0xffff) + base - rem;
+	if (sum1 >= base) sum1 -= base;
+	if (sum1 >= base) sum1 -= base;
+	if (sum2 >= (base << 1)) sum2 -= (base << 1);
+	if (sum2 >= base) sum2 -= base;
+	return sum1 | (sum2 << 16);
+}
+
+void PngWriter::WriteChunk(FILE *stream, const char *type, const unsigned char *data, size_t size)
+{
+	static unsigned int crc_table[256];
+	static bool crc_ready = []()
+	{
+		for (unsigned int n = 0; n < 256; n++)
+		{
+			unsigned int c = n;
+			for (int k = 0; k < 8; k++)
+				c = c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+			crc_table[n] = c;
+		}
+		return true;
+	}();
+	(void)crc_ready;
+
+	unsigned char length[4] = { (unsigned char)(size >> 24), (unsigned char)(size >> 16), (unsigned char)(size >> 8), (unsigned char)size };
+	fwrite(length, 1, 4, stream);
+	fwrite(type, 1, 4, stream);
+	if (size > 0)
+		fwrite(data, 1, size, stream);
+
+	unsigned int crc = ~0u;
+	for (int i = 0; i < 4; i++)
+		crc = crc_table[(crc ^ (unsigned char)type[i]) & 0xff] ^ (crc >> 8);
+	for (size_t i = 0; i < size; i++)
+		crc = crc_table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+	crc = ~crc;
+	unsigned char crc_bytes[4] = { (unsigned char)(crc >> 24), (unsigned char)(crc >> 16), (unsigned char)(crc >> 8), (unsigned char)crc };
+	fwrite(crc_bytes, 1, 4, stream);
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <stdio.h>
+#include <deque>
+#include <future>
+#include <memory>
+#include <vector>
+
+#define ADLER_BASE 65521
+#define ADLER_BLOCK 5552 // largest run of bytes before the adler32 sums can overflow 32 bits
+
+// png encoder with adaptive scanline filtering and deflate compression,
+// the filtered image is split into chunks compressed in parallel (like pigz)
+// each primed with the preceding 32 kb so matches can reach across chunk boundaries,
+// rows can be streamed in so only the chunks in flight are held in memory
+class PngWriter
+{
+public:
+	// threads 0 uses all hardware threads
+	PngWriter(unsigned int threads = 0);
+	// remove copy constructor/assignment
+	PngWriter(const PngWriter &) = delete;
+	PngWriter &operator=(const PngWriter &) = delete;
+	// closes the file if still open
+	~PngWriter();
+
+	// channels 1 (gray), 2 (gray alpha), 3 (rgb) or 4 (rgba),
+	// bit_depth 8 (unsigned char samples) or 16 (unsigned short samples)
+	bool Open(const char *png_file, unsigned int width, unsigned int height, int channels, int bit_depth);
+	// append rows ordered top to bottom, full chunks are compressed in the background
+	void WriteRows(const void *pixels, unsigned int rows);
+	// compress the remaining data, write the trailer and close the file
+	bool Close();
+
+	// encode a whole image in one call
+	static bool Write(const char *png_file, unsigned int width, unsigned int height, int channels, int bit_depth,
+		const void *pixels, unsigned int threads = 0);
+
+private:
+	typedef std::vector<unsigned char> Bytes;
+
+	struct Chunk
+	{
+		Bytes input; // preceding window followed by the chunk data
+		size_t begin; // start of the chunk data in input
+		Bytes output;
+		unsigned int adler;
+		std::future<void> done;
+	};
+
+	unsigned int threads;
+	FILE *stream = nullptr;
+	unsigned int width = 0, height = 0;
+	int channels = 0, bit_depth = 0;
+	unsigned int rows_written = 0;
+
+	Bytes above; // last unfiltered row in png byte order
+	Bytes pending; // already submitted history followed by filtered bytes not yet submitted
+	size_t pending_begin = 0;
+	std::deque<std::unique_ptr<Chunk>> chunks; // submitted chunks in file order
+	unsigned int adler = 1;
+
+	size_t RowSize() const { return (size_t)width * channels * (bit_depth / 8); }
+	// compress the next count pending bytes as one chunk
+	void Submit(size_t count, bool final);
+	// write finished chunks in order, waiting until at most max_in_flight remain
+	void Flush(size_t max_in_flight);
+
+	// choose the filter with the smallest sum of absolute residuals for each row,
+	// above is the unfiltered row preceding first_row when first_row is 0
+	static void FilterRows(const void *pixels, unsigned int width, int channels, int bit_depth,
+		unsigned int first_row, unsigned int last_row, const unsigned char *above, unsigned char *filtered);
+	// deflate data[begin, end) as a sequence of byte aligned blocks, the final chunk sets BFINAL
+	static void Deflate(const unsigned char *data, size_t begin, size_t end, bool final, Bytes &out);
+
+	// runs the variant of CpuFeatures::GetIsa
+	static unsigned int Adler32(const unsigned char *data, size_t size);
+	// variants continuing the checksum adler, in PngWriterSimd.cpp except the scalar one
+	static unsigned int Adler32Scalar(const unsigned char *data, size_t size, unsigned int adler);
+	static unsigned int Adler32SSE42(const unsigned char *data, size_t size, unsigned int adler);
+	static unsigned int Adler32AVX2(const unsigned char *data, size_t size, unsigned int adler);
+	static unsigned int Adler32AVX512(const unsigned char *data, size_t size, unsigned int adler);
+	static unsigned int Adler32Combine(unsigned int adler1, unsigned int adler2, size_t size2);
+	static void WriteChunk(FILE *stream, const char *type, const unsigned char *data, size_t size);
+};
@@ -0,0 +1,131 @@
+#include <immintrin.h>
+#include <algorithm>
+
+#include "PngWriter.h"
+#include "CpuFeatures.h"
+
+using namespace std;
+
+// adler32 over whole vectors: per run of blocks that can not overflow, a gathers the byte sums
+// and b the byte sums weighted by their distance to the end of the block, plus every earlier
+// block's sum of a once for each byte after it. the remaining tail runs the scalar loop
+
+ISA_TARGET("sse4.2,ssse3")
+unsigned int PngWriter::Adler32SSE42(const unsigned char *data, size_t size, unsigned int adler)
+{
+	const size_t block = 32;
+	unsigned int a = adler & 0xffff, b = adler >> 16;
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i ones = _mm_set1_epi16(1);
+	const __m128i tap1 = _mm_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17);
+	const __m128i tap2 = _mm_setr_epi8(16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+	size_t blocks = size / block;
+	while (blocks > 0)
+	{
+		size_t n = min(blocks, (size_t)ADLER_BLOCK / block);
+		blocks -= n;
+		b += a * (unsigned int)(n * block);
+		__m128i sum_a = zero, prefix_a = zero, sum_b = zero;
+		for (size_t i = 0; i < n; i++)
+		{
+			__m128i bytes1 = _mm_loadu_si128((const __m128i *)data);
+			__m128i bytes2 = _mm_loadu_si128((const __m128i *)(data + 16));
+			prefix_a = _mm_add_epi32(prefix_a, sum_a);
+			sum_a = _mm_add_epi32(sum_a, _mm_add_epi32(_mm_sad_epu8(bytes1, zero), _mm_sad_epu8(bytes2, zero)));
+			sum_b = _mm_add_epi32(sum_b, _mm_madd_epi16(_mm_maddubs_epi16(bytes1, tap1), ones));
+			sum_b = _mm_add_epi32(sum_b, _mm_madd_epi16(_mm_maddubs_epi16(bytes2, tap2), ones));
+			data += block;
+		}
+		sum_b = _mm_add_epi32(sum_b, _mm_slli_epi32(prefix_a, 5));
+		sum_a = _mm_add_epi32(sum_a, _mm_shuffle_epi32(sum_a, _MM_SHUFFLE(1, 0, 3, 2)));
+		sum_b = _mm_add_epi32(sum_b, _mm_shuffle_epi32(sum_b, _MM_SHUFFLE(1, 0, 3, 2)));
+		sum_b = _mm_add_epi32(sum_b, _mm_shuffle_epi32(sum_b, _MM_SHUFFLE(2, 3, 0, 1)));
+		a += (unsigned int)_mm_cvtsi128_si32(sum_a);
+		b += (unsigned int)_mm_cvtsi128_si32(sum_b);
+		a %= ADLER_BASE;
+		b %= ADLER_BASE;
+	}
+	return Adler32Scalar(data, size % block, b << 16 | a);
+}
+
+ISA_TARGET("avx2")
+unsigned int PngWriter::Adler32AVX2(const unsigned char *data, size_t size, unsigned int adler)
+{
+	const size_t block = 32;
+	unsigned int a = adler & 0xffff, b = adler >> 16;
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i ones = _mm256_set1_epi16(1);
+	const __m256i tap = _mm256_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17,
+		16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+	size_t blocks = size / block;
+	while (blocks > 0)
+	{
+		size_t n = min(blocks, (size_t)ADLER_BLOCK / block);
+		blocks -= n;
+		b += a * (unsigned int)(n * block);
+		__m256i sum_a = zero, prefix_a = zero, sum_b = zero;
+		for (size_t i = 0; i < n; i++)
+		{
+			__m256i bytes = _mm256_loadu_si256((const __m256i *)data);
+			prefix_a = _mm256_add_epi32(prefix_a, sum_a);
+			sum_a = _mm256_add_epi32(sum_a, _mm256_sad_epu8(bytes, zero));
+			sum_b = _mm256_add_epi32(sum_b, _mm256_madd_epi16(_mm256_maddubs_epi16(bytes, tap), ones));
+			data += block;
+		}
+		sum_b = _mm256_add_epi32(sum_b, _mm256_slli_epi32(prefix_a, 5));
+		__m128i a4 = _mm_add_epi32(_mm256_castsi256_si128(sum_a), _mm256_extracti128_si256(sum_a, 1));
+		__m128i b4 = _mm_add_epi32(_mm256_castsi256_si128(sum_b), _mm256_extracti128_si256(sum_b, 1));
+		a4 = _mm_add_epi32(a4, _mm_shuffle_epi32(a4, _MM_SHUFFLE(1, 0, 3, 2)));
+		b4 = _mm_add_epi32(b4, _mm_shuffle_epi32(b4, _MM_SHUFFLE(1, 0, 3, 2)));
+		b4 = _mm_add_epi32(b4, _mm_shuffle_epi32(b4, _MM_SHUFFLE(2, 3, 0, 1)));
+		a += (unsigned int)_mm_cvtsi128_si32(a4);
+		b += (unsigned int)_mm_cvtsi128_si32(b4);
+		a %= ADLER_BASE;
+		b %= ADLER_BASE;
+	}
+	return Adler32Scalar(data, size % block, b << 16 | a);
+}
+
+ISA_TARGET("avx512f,avx512bw")
+unsigned int PngWriter::Adler32AVX512(const unsigned char *data, size_t size, unsigned int adler)
+{
+	const size_t block = 64;
+	unsigned int a = adler & 0xffff, b = adler >> 16;
+	const __m512i zero = _mm512_setzero_si512();
+	const __m512i ones = _mm512_set1_epi16(1);
+	// taps 64 down to 1, _mm512_set_epi8 lists the highest byte first
+	const __m512i tap = _mm512_set_epi8(1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16,
+		17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32,
+		33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43, 44, 45, 46, 47, 48,
+		49, 50, 51, 52, 53, 54, 55, 56, 57, 58, 59, 60, 61, 62, 63, 64);
+	size_t blocks = size / block;
+	while (blocks > 0)
+	{
+		size_t n = min(blocks, (size_t)ADLER_BLOCK / block);
+		blocks -= n;
+		b += a * (unsigned int)(n * block);
+		__m512i sum_a = zero, prefix_a = zero, sum_b = zero;
+		for (size_t i = 0; i < n; i++)
+		{
+			__m512i bytes = _mm512_loadu_si512((const void *)data);
+			prefix_a = _mm512_add_epi32(prefix_a, sum_a);
+			sum_a = _mm512_add_epi32(sum_a, _mm512_sad_epu8(bytes, zero));
+			sum_b = _mm512_add_epi32(sum_b, _mm512_madd_epi16(_mm512_maddubs_epi16(bytes, tap), ones));
+			data += block;
+		}
+		// zero masked forms, gcc warns about the undefined sources of the unmasked shift and extract
+		sum_b = _mm512_add_epi32(sum_b, _mm512_maskz_slli_epi32((__mmask16)-1, prefix_a, 6));
+		__m256i a8 = _mm256_add_epi32(_mm512_maskz_extracti64x4_epi64(0xf, sum_a, 0), _mm512_maskz_extracti64x4_epi64(0xf, sum_a, 1));
+		__m256i b8 = _mm256_add_epi32(_mm512_maskz_extracti64x4_epi64(0xf, sum_b, 0), _mm512_maskz_extracti64x4_epi64(0xf, sum_b, 1));
+		__m128i a4 = _mm_add_epi32(_mm256_castsi256_si128(a8), _mm256_extracti128_si256(a8, 1));
+		__m128i b4 = _mm_add_epi32(_mm256_castsi256_si128(b8), _mm256_extracti128_si256(b8, 1));
+		a4 = _mm_add_epi32(a4, _mm_shuffle_epi32(a4, _MM_SHUFFLE(1, 0, 3, 2)));
+		b4 = _mm_add_epi32(b4, _mm_shuffle_epi32(b4, _MM_SHUFFLE(1, 0, 3, 2)));
+		b4 = _mm_add_epi32(b4, _mm_shuffle_epi32(b4, _MM_SHUFFLE(2, 3, 0, 1)));
+		a += (unsigned int)_mm_cvtsi128_si32(a4);
+		b += (unsigned int)_mm_cvtsi128_si32(b4);
+		a %= ADLER_BASE;
+		b %= ADLER_BASE;
+	}
+	return Adler32Scalar(data, size % block, b << 16 | a);
+}
@@ -0,0 +1,582 @@
+#include <string.h>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include "Renderer.h"
+#include "NoiseAsset.h"
+#include "Trace.h"
+
+struct QualityPreset
+{
+	const char *name;
+	int ray_depth;
+	int samples;
+};
+
+// indexed by Quality
+static const QualityPreset quality_presets[] = {
+	{ "draft", 3, 8 },
+	{ "default", 5, 16 },
+	{ "high", 8, MAX_SAMPLE },
+};
+
+Renderer::Renderer(int width, int height, const char *scene_file, Quality quality) : width(width), height(height)
+{
+	CreateQuad();
+	LoadNoise(NOISE_ASSET, NOISE_PNG);
+
+	// a missing or invalid scene still renders the light alone, but leaves the renderer invalid
+	// so offscreen renders fail instead of writing the wrong image
+	Scene scene;
+	if (scene.Load(scene_file))
+		this->scene_file = scene_file;
+	else
+		scene = Scene();
+	BuildRayShader(scene, quality);
+	if (!IsValid())
+		std::cout << "scene " << scene_file << " could not be loaded or built" << std::endl;
+
+	// ping-pong accumulation targets, avoids sampling the texture being rendered to
+	glGenTextures(2, accum_buffer);
+	glGenFramebuffers(2, accum_fbo);
+	glGenTextures(1, &preview_buffer);
+	glGenFramebuffers(1, &preview_fbo);
+	glGenBuffers(2, tile_buffer);
+	Resize(width, height);
+	for (int i = 0; i < 3; i++)
+	{
+		unsigned int target = i < 2 ? accum_buffer[i] : preview_buffer;
+		glBindTexture(GL_TEXTURE_2D, target);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, i < 2 ? accum_fbo[i] : preview_fbo);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target, 0);
+
+		GLenum DrawBuffers[] = { GL_COLOR_ATTACHMENT0 };
+		glDrawBuffers(1, DrawBuffers);
+
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+			std::cout << "ERROR::FRAMEBUFFER:: Framebuffer is not complete!" << std::endl;
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	Clear();
+}
+
+Renderer::~Renderer()
+{
+	glDeleteFramebuffers(2, accum_fbo);
+	glDeleteFramebuffers(1, &preview_fbo);
+	glDeleteTextures(2, accum_buffer);
+	glDeleteTextures(1, &preview_buffer);
+	glDeleteBuffers(2, tile_buffer);
+	glDeleteBuffers(1, &profile_buffer);
+	glDeleteTextures(1, &noise_texture);
+	glDeleteVertexArrays(1, &vao);
+	glDeleteBuffers(1, &vbo);
+	glDeleteBuffers(1, &ebo);
+}
+
+void Renderer::Resize(int width, int height)
+{
+	this->width = width;
+	this->height = height;
+	SetTile(0, 0, width, height);
+
+	// rgb holds the radiance sum and alpha the number of accumulated iterations
+	for (int i = 0; i < 2; i++)
+	{
+		glBindTexture(GL_TEXTURE_2D, accum_buffer[i]);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width, height, 0, GL_RGBA, GL_FLOAT, nullptr);
+	}
+	glBindTexture(GL_TEXTURE_2D, preview_buffer);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width, height, 0, GL_RGBA, GL_FLOAT, nullptr);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	if (profiling)
+		AllocateProfile();
+}
+
+void Renderer::Clear()
+{
+	for (int i = 0; i < 2; i++)
+	{
+		glClearTexImage(accum_buffer[i], 0, GL_RGBA, GL_FLOAT, nullptr);
+	}
+	if (profiling)
+	{
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, profile_buffer);
+		glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	}
+	accum_index = 0;
+	iteration = 0;
+	display_level = 0;
+	band_y = 0;
+	band_rows = height;
+	ResetTiles();
+}
+
+void Renderer::BeginBand(int y, int rows)
+{
+	band_y = y;
+	band_rows = rows;
+	iteration = 0;
+	ResetTiles();
+}
+
+bool Renderer::SetScene(const char *scene_file, Quality quality)
+{
+	if (this->scene_file == scene_file && this->quality == quality)
+		return true;
+
+	Scene scene;
+	if (!scene.Load(scene_file))
+		return false;
+	this->scene_file = scene_file;
+	BuildRayShader(scene, quality);
+	return ray_shader.IsLinked();
+}
+
+bool Renderer::SetComputePath(bool enable)
+{
+	if (enable == compute_path)
+		return true;
+	if (enable && !compute_shader.IsLinked() && !BuildComputeShader())
+		return false;
+	compute_path = enable;
+	ResetTiles();
+	return true;
+}
+
+bool Renderer::ParseQuality(const char *name, Quality &quality)
+{
+	for (int i = 0; i < (int)(sizeof(quality_presets) / sizeof(quality_presets[0])); i++)
+	{
+		if (strcmp(name, quality_presets[i].name) == 0)
+		{
+			quality = (Quality)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+const char *Renderer::GetQualityName(Quality quality)
+{
+	return quality_presets[(int)quality].name;
+}
+
+ShaderOptions Renderer::GetRayOptions(const Scene &scene, Quality quality)
+{
+	// the scene is generated into the shader and the preset becomes compile time constants
+	const QualityPreset &preset = quality_presets[(int)quality];
+	ShaderOptions options;
+	options.defines.push_back({ "RAY_DEPTH", std::to_string(preset.ray_depth) });
+	options.defines.push_back({ "SAMPLE", std::to_string(preset.samples) });
+	options.defines.push_back({ "ITERATION", std::to_string(ITERATION) });
+	options.includes["scene.glsl"] = scene.GenerateGLSL();
+	return options;
+}
+
+bool Renderer::SetProfiling(bool enable)
+{
+	if (enable == profiling)
+		return true;
+	profiling = enable;
+	if (profiling)
+	{
+		glGenBuffers(1, &profile_buffer);
+		AllocateProfile();
+	}
+	else
+	{
+		glDeleteBuffers(1, &profile_buffer);
+		profile_buffer = 0;
+	}
+	LinkRayShaders();
+	return ray_shader.IsLinked();
+}
+
+void Renderer::ReadProfile(unsigned int *counters) const
+{
+	// fragment and compute passes wrote the counters through shader storage
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, profile_buffer);
+	glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, (size_t)width * height * PROFILE_COUNTERS * sizeof(unsigned int), counters);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void Renderer::AllocateProfile()
+{
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, profile_buffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, (size_t)width * height * PROFILE_COUNTERS * sizeof(unsigned int), nullptr, GL_DYNAMIC_READ);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void Renderer::SetTile(int origin_x, int origin_y, int canvas_width, int canvas_height)
+{
+	this->origin_x = origin_x;
+	this->origin_y = origin_y;
+	this->canvas_width = canvas_width;
+	this->canvas_height = canvas_height;
+}
+
+void Renderer::SetLight(float x, float y)
+{
+	light_x = x;
+	light_y = y;
+}
+
+void Renderer::RenderPass(int level)
+{
+	TRACE_SCOPE("ray pass");
+	TRACE_GPU_SCOPE("ray pass");
+	if (level == 0 && compute_path)
+	{
+		RenderComputePass();
+		return;
+	}
+
+	int scale = 1 << level;
+	if (level > 0)
+	{
+		// render into the bottom left of the preview buffer
+		glBindFramebuffer(GL_FRAMEBUFFER, preview_fbo);
+		glViewport(0, 0, (width + scale - 1) / scale, (height + scale - 1) / scale);
+	}
+	else
+	{
+		// accumulate into the back buffer on top of the front buffer, rows outside the band
+		// are left alone so only the current band is valid in the front buffer
+		glBindFramebuffer(GL_FRAMEBUFFER, accum_fbo[1 - accum_index]);
+		glViewport(0, 0, width, height);
+		glEnable(GL_SCISSOR_TEST);
+		glScissor(0, band_y, width, band_rows);
+	}
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, noise_texture);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, accum_buffer[accum_index]);
+
+	ray_shader.Use();
+	{
+		TRACE_SCOPE("uniform upload");
+		glUniform2f(uniform_viewport_size, canvas_width, canvas_height);
+		glUniform2f(uniform_tile_origin, origin_x, origin_y);
+		glUniform2f(uniform_light_position, light_x, light_y);
+		glUniform1f(uniform_pixel_scale, scale);
+		glUniform1i(uniform_accumulate, level == 0);
+		int a[MAX_SAMPLE];
+		GetSampleAngles(a);
+		glUniform1iv(uniform_rangle, samples, a);
+		glUniform1i(uniform_profile_width, width);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, profile_buffer);
+	}
+
+	DrawQuad();
+	glDisable(GL_SCISSOR_TEST);
+	// the next pass adds to the counters written by this one
+	if (profiling)
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+	if (level == 0)
+	{
+		iteration++;
+		accum_index = 1 - accum_index;
+	}
+	display_level = level;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(0, 0, width, height);
+}
+
+void Renderer::RenderComputePass()
+{
+	// the accumulation is updated in place, the pass appends the tiles still changing to the
+	// next list which is dispatched by the following pass
+	unsigned int zero = 0;
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, tile_buffer[1 - tile_index]);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(zero), &zero);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, tile_buffer[tile_index]);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, tile_buffer[1 - tile_index]);
+	glBindImageTexture(0, accum_buffer[accum_index], 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, noise_texture);
+
+	compute_shader.Use();
+	{
+		TRACE_SCOPE("uniform upload");
+		glUniform2f(uniform_compute_viewport_size, canvas_width, canvas_height);
+		glUniform2f(uniform_compute_tile_origin, origin_x, origin_y);
+		glUniform2f(uniform_compute_light_position, light_x, light_y);
+		glUniform2i(uniform_compute_band, band_y, band_y + band_rows);
+		int a[MAX_SAMPLE];
+		GetSampleAngles(a);
+		glUniform1iv(uniform_compute_rangle, samples, a);
+		glUniform1i(uniform_compute_profile_width, width);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, profile_buffer);
+	}
+
+	glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, tile_buffer[tile_index]);
+	glDispatchComputeIndirect(0);
+	glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+	// the accumulation and tile lists are next used by draws, readbacks, buffer updates and dispatches
+	glMemoryBarrier(GL_ALL_BARRIER_BITS);
+
+	tile_index = 1 - tile_index;
+	iteration++;
+	display_level = 0;
+}
+
+void Renderer::ResetTiles()
+{
+	if (!compute_path)
+		return;
+
+	// tile lists start with the dispatch command, tiles are packed as x | y << 16
+	int tiles_x = (width + GROUP_SIZE - 1) / GROUP_SIZE;
+	int first_row = band_y / GROUP_SIZE;
+	int last_row = band_rows > 0 ? (band_y + band_rows - 1) / GROUP_SIZE : first_row - 1;
+	std::vector<unsigned int> tiles = { 0, 1, 1 };
+	for (int y = first_row; y <= last_row; y++)
+	{
+		for (int x = 0; x < tiles_x; x++)
+		{
+			tiles.push_back(x | y << 16);
+		}
+	}
+	tiles[0] = (unsigned int)tiles.size() - 3;
+
+	// the next list may receive every tile of the active one
+	for (int i = 0; i < 2; i++)
+	{
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, tile_buffer[i]);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, tiles.size() * sizeof(unsigned int), tiles.data(), GL_DYNAMIC_DRAW);
+	}
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	tile_index = 0;
+}
+
+size_t Renderer::GetTileListSize() const
+{
+	return 3 + (size_t)((width + GROUP_SIZE - 1) / GROUP_SIZE) * ((height + GROUP_SIZE - 1) / GROUP_SIZE);
+}
+
+void Renderer::CopyTileList(unsigned int buffer, size_t offset) const
+{
+	// the lists are allocated for every tile of the band, the count in front tells how many are used
+	GLint64 size;
+	glBindBuffer(GL_COPY_READ_BUFFER, tile_buffer[tile_index]);
+	glGetBufferParameteri64v(GL_COPY_READ_BUFFER, GL_BUFFER_SIZE, &size);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, offset, size);
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void Renderer::LoadTileList(const unsigned int *words)
+{
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, tile_buffer[tile_index]);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, (3 + words[0]) * sizeof(unsigned int), words);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void Renderer::GetSampleAngles(int *angles) const
+{
+	// interleave sample angles between iterations so every iteration covers the full circle
+	for (int i = 0; i < samples; i++)
+	{
+		angles[i] = i * ITERATION + iteration % ITERATION;
+	}
+}
+
+void Renderer::DrawQuad()
+{
+	glBindVertexArray(vao);
+	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+	glBindVertexArray(0);
+}
+
+void Renderer::ReadRadiance(float *rgb, int y, int rows)
+{
+	TRACE_SCOPE("readback");
+	std::vector<float> accum((size_t)width * rows * 4);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, accum_fbo[accum_index]);
+	glReadPixels(0, y, width, rows, GL_RGBA, GL_FLOAT, accum.data());
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+	for (int i = 0; i < width * rows; i++)
+	{
+		float n = accum[i * 4 + 3];
+		for (int c = 0; c < 3; c++)
+		{
+			rgb[i * 3 + c] = n > 0 ? accum[i * 4 + c] / n : 0;
+		}
+	}
+}
+
+void Renderer::ReadAccumulation(float *rgba) const
+{
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, accum_fbo[accum_index]);
+	glReadPixels(0, 0, width, height, GL_RGBA, GL_FLOAT, rgba);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+}
+
+void Renderer::LoadAccumulation(const float *rgba, unsigned int iteration)
+{
+	glBindTexture(GL_TEXTURE_2D, accum_buffer[accum_index]);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_FLOAT, rgba);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	this->iteration = iteration;
+	display_level = 0;
+	ResetTiles();
+}
+
+void Renderer::CreateQuad()
+{
+	float vertices[] = {
+		// positions		// texture coords
+		 1.f,  1.f, 0.f,	1.f, 1.f,	// top right
+		 1.f, -1.f, 0.f,	1.f, 0.f,	// bottom right
+		-1.f, -1.f, 0.f,	0.f, 0.f,	// bottom left
+		-1.f,  1.f, 0.f,	0.f, 1.f	// top left 
+	};
+	unsigned int indices[] = {
+		0, 1, 3,   // first triangle
+		1, 2, 3    // second triangle
+	};
+
+	glGenVertexArrays(1, &vao);
+	glBindVertexArray(vao);
+
+	glGenBuffers(1, &vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+
+	glGenBuffers(1, &ebo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+
+	// positions
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_TRUE, 5 * sizeof(float), (void*)0);
+	glEnableVertexAttribArray(0);
+	// texture coords
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_TRUE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+	glEnableVertexAttribArray(1);
+
+	glBindVertexArray(0);
+}
+
+void Renderer::LoadNoise(const char *asset_file, const char *png_file)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	NoiseAsset noise;
+	bool loaded = noise.Load(asset_file);
+	if (!loaded && NoiseAsset::ConvertPNG(png_file, asset_file))
+	{
+		std::cout << "Converted " << png_file << " to " << asset_file << std::endl;
+		loaded = noise.Load(asset_file);
+	}
+
+	glGenTextures(1, &noise_texture);
+	glBindTexture(GL_TEXTURE_2D, noise_texture);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	// the mapped texels are uploaded directly, without a noise map the offset is constant
+	float zero = 0;
+	unsigned int width = loaded ? noise.GetWidth() : 1;
+	unsigned int height = loaded ? noise.GetHeight() : 1;
+	if (!loaded)
+		std::cout << "failed to load noise map, rendering without noise" << std::endl;
+	// disable mipmaps
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_R32F, width, height);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RED, GL_FLOAT, loaded ? noise.GetData() : &zero);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	noise_width = width;
+	noise_height = height;
+	noise_loaded = loaded;
+
+	auto end = std::chrono::high_resolution_clock::now();
+	std::cout << "Noise loaded in " << std::chrono::duration<double, std::milli>(end - start).count() << " ms" << std::endl;
+}
+
+void Renderer::BuildRayShader(const Scene &scene, Quality quality)
+{
+	ray_options = GetRayOptions(scene, quality);
+	this->quality = quality;
+	samples = quality_presets[(int)quality].samples;
+	LinkRayShaders();
+}
+
+void Renderer::LinkRayShaders()
+{
+	ray_shader = Shader("shader/ray.vert", "shader/ray.frag", GetVariantOptions());
+
+	uniform_viewport_size = ray_shader.GetUniform("viewport_size");
+	uniform_tile_origin = ray_shader.GetUniform("tile_origin");
+	uniform_pixel_scale = ray_shader.GetUniform("pixel_scale");
+	uniform_accumulate = ray_shader.GetUniform("accumulate");
+	uniform_light_position = ray_shader.GetUniform("light1.position");
+	uniform_rangle = ray_shader.GetUniform("rangle");
+	uniform_profile_width = ray_shader.GetUniform("profile_width");
+
+	ray_shader.Use();
+	glUniform1i(ray_shader.GetUniform("noise_map"), 0);
+	glUniform1i(ray_shader.GetUniform("frame_canvas"), 1);
+	glUniform2ui(ray_shader.GetUniform("noise_size"), noise_width, noise_height);
+
+	// keep the compute path on the new variant
+	compute_shader = Shader();
+	if (compute_path && !BuildComputeShader())
+	{
+		compute_path = false;
+		ResetTiles();
+	}
+}
+
+bool Renderer::BuildComputeShader()
+{
+	ShaderOptions options = GetVariantOptions();
+	options.defines.push_back({ "GROUP_SIZE", std::to_string(GROUP_SIZE) });
+	options.defines.push_back({ "MIN_TILE_ITERATION", std::to_string(MIN_TILE_ITERATION) });
+	options.defines.push_back({ "TILE_CONVERGENCE", std::to_string(TILE_CONVERGENCE) });
+	compute_shader = Shader("shader/ray.comp", options);
+	if (!compute_shader.IsLinked())
+	{
+		std::cout << "compute shader unavailable, rendering with the fragment shader" << std::endl;
+		compute_shader = Shader();
+		return false;
+	}
+
+	uniform_compute_viewport_size = compute_shader.GetUniform("viewport_size");
+	uniform_compute_tile_origin = compute_shader.GetUniform("tile_origin");
+	uniform_compute_light_position = compute_shader.GetUniform("light1.position");
+	uniform_compute_rangle = compute_shader.GetUniform("rangle");
+	uniform_compute_band = compute_shader.GetUniform("band");
+	uniform_compute_profile_width = compute_shader.GetUniform("profile_width");
+
+	compute_shader.Use();
+	glUniform1i(compute_shader.GetUniform("noise_map"), 0);
+	glUniform2ui(compute_shader.GetUniform("noise_size"), noise_width, noise_height);
+	return true;
+}
+
+ShaderOptions Renderer::GetVariantOptions() const
+{
+	ShaderOptions options = ray_options;
+	if (profiling)
+		options.defines.push_back({ "PROFILE", "1" });
+	return options;
+}
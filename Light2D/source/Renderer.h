@@ -0,0 +1,179 @@
+#pragma once
+#include <glad/glad.h>
+#include <string>
+#include "Shader.h"
+#include "Scene.h"
+
+#define ITERATION 32 // iterations of a converged image, defined in ray.frag by the renderer
+#define MAX_SAMPLE 32 // largest SAMPLE of the quality presets
+#define NOISE_ASSET "noise_map.noise"
+#define NOISE_PNG "noise_map.png"
+// the noise every golden image was rendered with, Light2D --create-noise writes it
+#define NOISE_SEED 42
+#define NOISE_SIZE 1024
+// preview levels rendered after an interaction, level n renders at 1/2^n resolution
+#define PREVIEW_LEVELS 3
+// width and height of the pixel tile a compute work group renders, the work group keeps
+// GROUP_SIZE^2 ray stacks in shared memory
+#define GROUP_SIZE 8
+// a tile stops accumulating on the compute path once it has this many iterations and its
+// mean radiance changed less than TILE_CONVERGENCE relative to its brightness in the last one
+#define MIN_TILE_ITERATION 8
+#define TILE_CONVERGENCE 0.05
+
+// ray depth and samples per iteration the ray shader is specialised for
+enum class Quality { Draft, Default, High };
+
+// per pixel cost recorded by profiling variants of the ray shaders, in profile buffer order,
+// all are sums over the accumulated passes except MaxDepth
+enum class ProfileCounter
+{
+	Steps, // sphere tracing steps
+	SceneCalls, // scene() evaluations including the ones of normal()
+	MaxDepth, // deepest ray stack entry used
+	Pushes, // reflected and refracted rays pushed to the stack
+	Exhausted, // rays that used up all march steps without hitting or leaving the scene
+};
+#define PROFILE_COUNTERS 5
+
+class Renderer
+{
+public:
+	Renderer(int width, int height, const char *scene_file = DEFAULT_SCENE, Quality quality = Quality::Default);
+	// remove copy constructor/assignment
+	Renderer(const Renderer &) = delete;
+	Renderer &operator=(const Renderer &) = delete;
+	~Renderer();
+
+	// reallocate accumulation and preview buffers, the accumulation must be cleared afterwards
+	void Resize(int width, int height);
+	// clear the accumulation to start a new progressive render of the whole frame
+	void Clear();
+	// restrict following accumulation passes to rows [y, y + rows) and restart the iteration count,
+	// the band must not have been rendered since the last Clear and the previous band must
+	// already be read back
+	void BeginBand(int y, int rows);
+	// render the buffer as the tile at origin of a larger canvas, light and scene are laid out
+	// on the canvas, Resize resets the canvas to the buffer size
+	void SetTile(int origin_x, int origin_y, int canvas_width, int canvas_height);
+	// specialise the ray shader for a scene description and quality, variants are cached so
+	// switching back to one that was compiled before only loads its binary
+	bool SetScene(const char *scene_file, Quality quality);
+	// false if the scene given to the constructor failed to load, the light is then rendered alone,
+	// or the ray shader of the current scene failed to build
+	bool IsValid() const { return !scene_file.empty() && ray_shader.IsLinked(); }
+	// false if no noise map was found and the sample offsets are constant
+	bool HasNoise() const { return noise_loaded; }
+	// identifies the scene and quality the current ray shader was generated for
+	unsigned long long GetSceneHash() const { return ray_shader.GetSourceHash(); }
+	static bool ParseQuality(const char *name, Quality &quality);
+	static const char *GetQualityName(Quality quality);
+	// defines and generated scene the ray shaders of a variant are compiled with
+	static ShaderOptions GetRayOptions(const Scene &scene, Quality quality);
+	// render accumulation passes with the compute shader, which skips tiles that stopped changing,
+	// instead of the fragment shader, returns false if the compute shader is not available
+	bool SetComputePath(bool enable);
+	bool IsComputePath() const { return compute_path; }
+	// record the cost of every accumulated pixel, the counters are only compiled into the
+	// shaders while profiling so they cost nothing otherwise, Clear resets them
+	bool SetProfiling(bool enable);
+	// width x height x PROFILE_COUNTERS counters in ProfileCounter order, rows ordered bottom to top
+	void ReadProfile(unsigned int *counters) const;
+	// light position in canvas pixels from the bottom left corner
+	void SetLight(float x, float y);
+	// draw one ray pass, level > 0 renders a single pass preview at 1/2^level resolution
+	void RenderPass(int level);
+	// draw the full screen quad with the program currently in use
+	void DrawQuad();
+	// read back the mean radiance of rows [y, y + rows) as rgb floats, rows ordered bottom to top
+	void ReadRadiance(float *rgb, int y, int rows);
+	// read back or restore the raw accumulation, width x height rgba floats with the
+	// iteration count in alpha, loading continues the progressive render at iteration,
+	// with a pixel pack buffer bound rgba is an offset into the buffer
+	void ReadAccumulation(float *rgba) const;
+	void LoadAccumulation(const float *rgba, unsigned int iteration);
+	// words of the compute path's tile list, the dispatch command followed by one word per tile
+	size_t GetTileListSize() const;
+	// queue a copy of the tiles still accumulating into a gl buffer at the byte offset,
+	// or restore them after LoadAccumulation, only valid on the compute path
+	void CopyTileList(unsigned int buffer, size_t offset) const;
+	void LoadTileList(const unsigned int *words);
+
+	int GetWidth() const { return width; }
+	int GetHeight() const { return height; }
+	unsigned int GetIteration() const { return iteration; }
+	// rays started per pixel and pass
+	int GetSamples() const { return samples; }
+	bool IsConverged() const { return iteration >= ITERATION; }
+	// texture and level of the last rendered pass, level 0 is the accumulation
+	unsigned int GetDisplayTexture() const { return display_level > 0 ? preview_buffer : accum_buffer[accum_index]; }
+	int GetDisplayLevel() const { return display_level; }
+
+private:
+	int width, height;
+	int origin_x = 0, origin_y = 0;
+	int canvas_width, canvas_height;
+	float light_x = 0, light_y = 0;
+	unsigned int iteration = 0;
+	int display_level = 0;
+	// rows covered by accumulation passes, the whole frame unless a band was begun
+	int band_y = 0, band_rows = 0;
+
+	unsigned int vao, vbo, ebo;
+	unsigned int noise_texture;
+	unsigned int noise_width = 1, noise_height = 1;
+	bool noise_loaded = false;
+
+	std::string scene_file;
+	Quality quality = Quality::Default;
+	int samples = 0;
+	Shader ray_shader;
+	int uniform_viewport_size;
+	int uniform_tile_origin;
+	int uniform_pixel_scale;
+	int uniform_accumulate;
+	int uniform_light_position;
+	int uniform_rangle;
+	int uniform_profile_width;
+	// options of the current variant, the compute shader is only built when first used
+	ShaderOptions ray_options;
+
+	bool compute_path = false;
+	Shader compute_shader;
+	int uniform_compute_viewport_size;
+	int uniform_compute_tile_origin;
+	int uniform_compute_light_position;
+	int uniform_compute_rangle;
+	int uniform_compute_band;
+	int uniform_compute_profile_width;
+	// tiles still accumulating, the active list is dispatched indirectly and the pass appends
+	// the tiles that have not converged to the other list
+	unsigned int tile_buffer[2];
+	unsigned int tile_index = 0;
+
+	bool profiling = false;
+	unsigned int profile_buffer = 0;
+
+	// float accumulation buffers, ray pass reads one and writes the other then swaps
+	unsigned int accum_buffer[2];
+	unsigned int accum_fbo[2];
+	unsigned int accum_index = 0;
+	// single pass low resolution target used while the scene is being edited
+	unsigned int preview_buffer;
+	unsigned int preview_fbo;
+
+	void CreateQuad();
+	void BuildRayShader(const Scene &scene, Quality quality);
+	// link the fragment and, if used, compute shader of the current variant
+	void LinkRayShaders();
+	ShaderOptions GetVariantOptions() const;
+	void AllocateProfile();
+	bool BuildComputeShader();
+	void RenderComputePass();
+	// restart the tile lists with every tile of the band
+	void ResetTiles();
+	// sample angle offsets of the current iteration
+	void GetSampleAngles(int *angles) const;
+	// map the binary noise asset, converting the png once if the asset is missing
+	void LoadNoise(const char *asset_file, const char *png_file);
+};
@@ -0,0 +1,445 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "Scene.h"
+
+using namespace std;
+
+#define TWO_PI 6.28318530717958647692
+
+bool Scene::Load(const char *scene_file)
+{
+	ifstream stream(scene_file);
+	if (!stream)
+	{
+		cout << "failed to open scene " << scene_file << endl;
+		return false;
+	}
+
+	name = scene_file;
+	objects.clear();
+	string line;
+	int line_number = 0;
+	while (getline(stream, line))
+	{
+		line_number++;
+		istringstream words(line.substr(0, line.find('#')));
+		string type;
+		if (!(words >> type))
+			continue;
+
+		bool valid = true;
+		if (type == "light")
+		{
+			valid = !!(words >> light_radius >> light_luminance[0] >> light_luminance[1] >> light_luminance[2]);
+		}
+		else
+		{
+			Object object = {};
+			object.csg = type == "subtract" ? Csg::Subtract : type == "intersect" ? Csg::Intersect : Csg::Union;
+			if (object.csg != Csg::Union && (objects.empty() || !(words >> type)))
+			{
+				cout << "nothing to " << (object.csg == Csg::Subtract ? "subtract from" : "intersect with")
+					<< " at " << scene_file << ":" << line_number << endl;
+				return false;
+			}
+			int count;
+			if (type == "circle")
+			{
+				object.shape = Shape::Circle;
+				count = 3;
+			}
+			else if (type == "rectangle")
+			{
+				object.shape = Shape::Rectangle;
+				count = 5;
+			}
+			else if (type == "triangle" || type == "pentagon")
+			{
+				object.shape = type == "triangle" ? Shape::Triangle : Shape::Pentagon;
+				count = 4;
+			}
+			else
+			{
+				cout << "unknown object " << type << " at " << scene_file << ":" << line_number << endl;
+				return false;
+			}
+			for (int i = 0; i < count && valid; i++)
+			{
+				valid = !!(words >> object.params[i]);
+			}
+
+			string property;
+			while (valid && words >> property)
+			{
+				float *value = property == "emissive" ? object.emissive
+					: property == "reflective" ? object.reflective
+					: property == "refractive" ? object.refractive
+					: property == "absorption" ? object.absorption : nullptr;
+				// the material of a composed object comes from the object it modifies
+				valid = value != nullptr && object.csg == Csg::Union && !!(words >> value[0] >> value[1] >> value[2]);
+			}
+			objects.push_back(object);
+		}
+
+		if (!valid)
+		{
+			cout << "invalid " << type << " at " << scene_file << ":" << line_number << endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+string Scene::GenerateGLSL() const
+{
+	// objects are unrolled into a chain of unions with every constant folded in,
+	// the light stays a uniform so it can follow the cursor
+	string light_sdf = "circle_sdf(pos, light1.position / min(viewport_size.x, viewport_size.y), " + Float(light_radius) + ")";
+	vector<string> sdfs;
+	vector<const Object *> unrolled;
+	vector<const Object *> groups[4]; // indexed by Shape
+	// position of each object among the composed ones in file order, decides ties like union_op
+	vector<int> order(objects.size());
+	for (size_t i = 0; i < objects.size(); i++)
+	{
+		order[i] = (int)sdfs.size();
+		// subtracted and intersected shapes only change the distance, like subtract_op and
+		// intersect_op but keeping the material of the object they modify
+		const Object &object = objects[i];
+		string sdf = GenerateSDF(object);
+		bool composed = false;
+		for (; i + 1 < objects.size() && objects[i + 1].csg != Csg::Union; i++)
+		{
+			const Object &modifier = objects[i + 1];
+			sdf = "max(" + sdf + ", " + (modifier.csg == Csg::Subtract ? "-" : "") + GenerateSDF(modifier) + ")";
+			composed = true;
+		}
+		if (!composed)
+			groups[(int)object.shape].push_back(&object);
+		sdfs.push_back(sdf);
+		unrolled.push_back(&object);
+	}
+
+	// shapes too rare to be worth a loop stay unrolled
+	for (vector<const Object *> &group : groups)
+	{
+		if (group.size() >= SCENE_GROUP_SIZE)
+		{
+			for (size_t i = 0; i < unrolled.size(); i++)
+			{
+				if (find(group.begin(), group.end(), unrolled[i]) == group.end())
+					continue;
+				sdfs.erase(sdfs.begin() + i);
+				unrolled.erase(unrolled.begin() + i--);
+			}
+		}
+		else
+		{
+			group.clear();
+		}
+	}
+
+	// with any group every material goes into one table, four vec3 per distinct material
+	vector<const Object *> materials;
+	for (const vector<const Object *> &group : groups)
+	{
+		for (const Object *object : group)
+		{
+			if (MaterialOffset(*object, materials) < 0)
+				materials.push_back(object);
+		}
+	}
+	for (size_t i = 0; i < unrolled.size() && !materials.empty(); i++)
+	{
+		if (MaterialOffset(*unrolled[i], materials) < 0)
+			materials.push_back(unrolled[i]);
+	}
+	auto object_order = [&](const Object *object) { return order[object - objects.data()]; };
+
+	ostringstream glsl;
+	glsl << "// generated from " << name << "\n";
+	if (!materials.empty())
+	{
+		glsl << "const vec3 scene_materials[" << materials.size() * 4 << "] = vec3[](";
+		for (size_t i = 0; i < materials.size(); i++)
+		{
+			const Object &material = *materials[i];
+			glsl << (i > 0 ? "," : "") << "\n\t" << Vec3(material.emissive) << ", " << Vec3(material.reflective)
+				<< ", " << Vec3(material.refractive) << ", " << Vec3(material.absorption);
+		}
+		glsl << ");\n";
+	}
+	for (int shape = 0; shape < 4; shape++)
+	{
+		if (!groups[shape].empty())
+		{
+			vector<int> orders;
+			for (const Object *object : groups[shape])
+			{
+				orders.push_back(object_order(object));
+			}
+			glsl << GenerateArrays((Shape)shape, groups[shape], orders, materials);
+		}
+	}
+
+	glsl << (materials.empty() ? "" : "\n")
+		<< "result scene(float x, float y)\n"
+		<< "{\n"
+		<< "\tvec2 pos = vec2(x, y);\n";
+	if (materials.empty())
+	{
+		glsl << "\tresult r = result(" << light_sdf << ", " << Vec3(light_luminance) << ", vec3(0), vec3(0), vec3(0));\n";
+		for (size_t i = 0; i < sdfs.size(); i++)
+		{
+			const Object &object = *unrolled[i];
+			glsl << "\tr = union_op(r, result(" << sdfs[i] << ", " << Vec3(object.emissive) << ", "
+				<< Vec3(object.reflective) << ", " << Vec3(object.refractive) << ", " << Vec3(object.absorption) << "));\n";
+		}
+		glsl << "\treturn r;\n";
+	}
+	else
+	{
+		// only the distance, material offset m and file position k of the nearest object are tracked
+		// and the result is built once, an object wins ties against earlier ones like in union_op
+		// so the groups pick the same material as the unrolled chain wherever shapes touch
+		glsl << "\tfloat d = " << light_sdf << ";\n"
+			<< "\tint m = -1;\n"
+			<< "\tint k = -1;\n"
+			<< "\tfloat di;\n";
+		for (size_t i = 0; i < sdfs.size(); i++)
+		{
+			int o = object_order(unrolled[i]);
+			glsl << "\tdi = " << sdfs[i] << ";\n"
+				<< "\tif (di < d || (di == d && " << o << " > k))\n"
+				<< "\t{\n"
+				<< "\t\td = di;\n"
+				<< "\t\tm = " << MaterialOffset(*unrolled[i], materials) << ";\n"
+				<< "\t\tk = " << o << ";\n"
+				<< "\t}\n";
+		}
+		for (int shape = 0; shape < 4; shape++)
+		{
+			if (!groups[shape].empty())
+				glsl << GenerateLoop((Shape)shape, groups[shape].size(), true);
+		}
+		glsl << "\tif (m < 0)\n"
+			<< "\t\treturn result(d, " << Vec3(light_luminance) << ", vec3(0), vec3(0), vec3(0));\n"
+			<< "\treturn result(d, scene_materials[m], scene_materials[m + 1], scene_materials[m + 2], scene_materials[m + 3]);\n";
+	}
+	glsl << "}\n";
+
+	// the same distance without selecting materials, for sphere tracing steps and normals
+	glsl << "\n"
+		<< "float scene_distance(float x, float y)\n"
+		<< "{\n"
+		<< "\tvec2 pos = vec2(x, y);\n"
+		<< "\tfloat d = " << light_sdf << ";\n";
+	for (const string &sdf : sdfs)
+	{
+		glsl << "\td = min(d, " << sdf << ");\n";
+	}
+	for (int shape = 0; shape < 4; shape++)
+	{
+		if (!groups[shape].empty())
+			glsl << GenerateLoop((Shape)shape, groups[shape].size(), false);
+	}
+	glsl << "\treturn d;\n"
+		<< "}\n";
+	return glsl.str();
+}
+
+string Scene::GenerateSDF(const Object &object) const
+{
+	const float *p = object.params;
+	string center = Vec2(p[0], p[1]);
+	ostringstream sdf;
+	switch (object.shape)
+	{
+	case Shape::Circle:
+		sdf << "circle_sdf(pos, " << center << ", " << Float(p[2]) << ")";
+		break;
+	case Shape::Rectangle:
+	{
+		// rotation folded into a constant matrix
+		double c = cos(p[4]), s = sin(p[4]);
+		sdf << "box_sdf(mat2(" << Float(c) << ", " << Float(-s) << ", " << Float(s) << ", " << Float(c)
+			<< ") * (pos - " << center << "), " << Vec2(p[2], p[3]) << ")";
+		break;
+	}
+	case Shape::Triangle:
+	case Shape::Pentagon:
+	{
+		// regular polygon vertices precomputed in scene space, clockwise from the angle
+		int n = object.shape == Shape::Triangle ? 3 : 5;
+		sdf << (n == 3 ? "triangle_sdf" : "pentagon_sdf") << "(pos, vec2[" << n << "](";
+		for (int i = 0; i < n; i++)
+		{
+			sdf << (i > 0 ? ", " : "") << Vertex(object, i);
+		}
+		sdf << "))";
+		break;
+	}
+	}
+	return sdf.str();
+}
+
+// indexed by Shape
+static const char *shape_names[] = { "circle", "rectangle", "triangle", "pentagon" };
+
+string Scene::GenerateArrays(Shape shape, const vector<const Object *> &group, const vector<int> &orders,
+	const vector<const Object *> &materials) const
+{
+	// one array per parameter set, circles as center and radius, rectangles as center and
+	// rotation next to their half sizes, polygons as consecutive vertices
+	string array = string("scene_") + shape_names[(int)shape] + "s";
+	int vertices = shape == Shape::Triangle ? 3 : shape == Shape::Pentagon ? 5 : 1;
+	const char *type = shape == Shape::Circle ? "vec3" : shape == Shape::Rectangle ? "vec4" : "vec2";
+	ostringstream glsl;
+	glsl << "const " << type << " " << array << "[" << group.size() * vertices << "] = " << type << "[](";
+	for (size_t i = 0; i < group.size(); i++)
+	{
+		const float *p = group[i]->params;
+		glsl << (i > 0 ? "," : "") << "\n\t";
+		if (shape == Shape::Circle)
+		{
+			glsl << "vec3(" << Float(p[0]) << ", " << Float(p[1]) << ", " << Float(p[2]) << ")";
+		}
+		else if (shape == Shape::Rectangle)
+		{
+			glsl << "vec4(" << Float(p[0]) << ", " << Float(p[1]) << ", " << Float(cos(p[4])) << ", " << Float(sin(p[4])) << ")";
+		}
+		else
+		{
+			for (int v = 0; v < vertices; v++)
+			{
+				glsl << (v > 0 ? ", " : "") << Vertex(*group[i], v);
+			}
+		}
+	}
+	glsl << ");\n";
+
+	if (shape == Shape::Rectangle)
+	{
+		glsl << "const vec2 scene_rectangle_sizes[" << group.size() << "] = vec2[](";
+		for (size_t i = 0; i < group.size(); i++)
+		{
+			glsl << (i > 0 ? ", " : "") << Vec2(group[i]->params[2], group[i]->params[3]);
+		}
+		glsl << ");\n";
+	}
+
+	// offsets of the first of the four colors of each material in scene_materials
+	glsl << "const int scene_" << shape_names[(int)shape] << "_materials[" << group.size() << "] = int[](";
+	for (size_t i = 0; i < group.size(); i++)
+	{
+		glsl << (i > 0 ? ", " : "") << MaterialOffset(*group[i], materials);
+	}
+	glsl << ");\n";
+
+	// positions of the objects in the file
+	glsl << "const int scene_" << shape_names[(int)shape] << "_orders[" << group.size() << "] = int[](";
+	for (size_t i = 0; i < group.size(); i++)
+	{
+		glsl << (i > 0 ? ", " : "") << orders[i];
+	}
+	glsl << ");\n";
+	return glsl.str();
+}
+
+string Scene::GenerateLoop(Shape shape, size_t count, bool track_material)
+{
+	// the same expressions as GenerateSDF with the constants read from the arrays
+	string array = string("scene_") + shape_names[(int)shape] + "s";
+	string sdf;
+	switch (shape)
+	{
+	case Shape::Circle:
+		sdf = "circle_sdf(pos, " + array + "[i].xy, " + array + "[i].z)";
+		break;
+	case Shape::Rectangle:
+		sdf = "box_sdf(mat2(" + array + "[i].z, -" + array + "[i].w, " + array + "[i].w, " + array + "[i].z) * (pos - "
+			+ array + "[i].xy), scene_rectangle_sizes[i])";
+		break;
+	case Shape::Triangle:
+		sdf = "triangle_sdf(pos, vec2[3](" + array + "[i * 3], " + array + "[i * 3 + 1], " + array + "[i * 3 + 2]))";
+		break;
+	case Shape::Pentagon:
+		sdf = "pentagon_sdf(pos, vec2[5](" + array + "[i * 5], " + array + "[i * 5 + 1], " + array + "[i * 5 + 2], "
+			+ array + "[i * 5 + 3], " + array + "[i * 5 + 4]))";
+		break;
+	}
+
+	ostringstream glsl;
+	glsl << "\tfor (int i = 0; i < " << count << "; i++)\n"
+		<< "\t{\n";
+	if (track_material)
+	{
+		// ties go to the later object in the file like union_op
+		string name = string("scene_") + shape_names[(int)shape];
+		glsl << "\t\tdi = " << sdf << ";\n"
+			<< "\t\tbool nearer = di < d || (di == d && " << name << "_orders[i] > k);\n"
+			<< "\t\td = nearer ? di : d;\n"
+			<< "\t\tm = nearer ? " << name << "_materials[i] : m;\n"
+			<< "\t\tk = nearer ? " << name << "_orders[i] : k;\n";
+	}
+	else
+	{
+		glsl << "\t\td = min(d, " << sdf << ");\n";
+	}
+	glsl << "\t}\n";
+	return glsl.str();
+}
+
+string Scene::Vertex(const Object &object, int i)
+{
+	// regular polygon vertices precomputed in scene space, clockwise from the angle
+	const float *p = object.params;
+	int n = object.shape == Shape::Triangle ? 3 : 5;
+	double a = p[3] - TWO_PI * i / n;
+	return Vec2(p[0] + p[2] * cos(a), p[1] + p[2] * sin(a));
+}
+
+int Scene::MaterialOffset(const Object &object, const vector<const Object *> &materials)
+{
+	for (size_t i = 0; i < materials.size(); i++)
+	{
+		if (SameMaterial(object, *materials[i]))
+			return (int)i * 4;
+	}
+	return -1;
+}
+
+bool Scene::SameMaterial(const Object &a, const Object &b)
+{
+	return memcmp(a.emissive, b.emissive, sizeof(a.emissive)) == 0
+		&& memcmp(a.reflective, b.reflective, sizeof(a.reflective)) == 0
+		&& memcmp(a.refractive, b.refractive, sizeof(a.refractive)) == 0
+		&& memcmp(a.absorption, b.absorption, sizeof(a.absorption)) == 0;
+}
+
+string Scene::Float(double value)
+{
+	char text[32];
+	snprintf(text, sizeof(text), "%.9g", value);
+	// keep literals floating point
+	string literal = text;
+	if (literal.find_first_of(".e") == string::npos)
+		literal += ".0";
+	return literal;
+}
+
+string Scene::Vec2(double x, double y)
+{
+	return "vec2(" + Float(x) + ", " + Float(y) + ")";
+}
+
+string Scene::Vec3(const float *v)
+{
+	return "vec3(" + Float(v[0]) + ", " + Float(v[1]) + ", " + Float(v[2]) + ")";
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <string>
+#include <vector>
+
+#define DEFAULT_SCENE "scene/default.scene"
+// objects of one shape before they are grouped into arrays evaluated in a loop instead of unrolled
+#define SCENE_GROUP_SIZE 8
+
+// scene description loaded from a text file and turned into a specialised glsl scene()
+// with every object and material inlined as constants, one object per line:
+//   light radius r g b
+//   circle cx cy radius [material]
+//   rectangle cx cy half_width half_height angle [material]
+//   triangle cx cy radius angle [material]
+//   pentagon cx cy radius angle [material]
+// material is any of reflective r g b, refractive r g b, absorption r g b, emissive r g b,
+// coordinates are in units of the shorter viewport side and # starts a comment.
+// a shape line starting with subtract or intersect carves or clips the object before it
+// instead of adding one, takes no material and is folded into that object's distance:
+//   subtract circle cx cy radius
+//   intersect rectangle cx cy half_width half_height angle
+// plain objects of a shape that occurs SCENE_GROUP_SIZE times or more are stored as constant
+// arrays per shape with a material index each, so large scenes compile to one short loop per shape,
+// where objects touch the later one in the file still wins like in the unrolled chain of unions
+class Scene
+{
+public:
+	Scene() { };
+
+	bool Load(const char *scene_file);
+	// glsl source defining result scene(float x, float y), the nearest object and its material,
+	// and float scene_distance(float x, float y), the same distance without the material
+	std::string GenerateGLSL() const;
+
+private:
+	enum class Shape { Circle, Rectangle, Triangle, Pentagon };
+	enum class Csg { Union, Subtract, Intersect };
+
+	struct Object
+	{
+		Shape shape;
+		// how the object combines with the preceding one
+		Csg csg;
+		float params[5];
+		float emissive[3];
+		float reflective[3];
+		float refractive[3];
+		float absorption[3];
+	};
+
+	std::string name;
+	float light_radius = 0.04f;
+	float light_luminance[3] = { 8, 8, 8 };
+	std::vector<Object> objects;
+
+	std::string GenerateSDF(const Object &object) const;
+	// constant arrays of the parameters, material offsets and file positions of a group of objects of one shape
+	std::string GenerateArrays(Shape shape, const std::vector<const Object *> &group, const std::vector<int> &orders,
+		const std::vector<const Object *> &materials) const;
+	// loop folding a group into the distance d, and into the material offset m and file position k if tracked
+	static std::string GenerateLoop(Shape shape, size_t count, bool track_material);
+	static std::string Vertex(const Object &object, int i);
+	// offset of the object's material in scene_materials, -1 if it is not in the table
+	static int MaterialOffset(const Object &object, const std::vector<const Object *> &materials);
+	static bool SameMaterial(const Object &a, const Object &b);
+	static std::string Float(double value);
+	static std::string Vec2(double x, double y);
+	static std::string Vec3(const float *v);
+};
@@ -1,30 +1,93 @@
 #include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <string>
 #include "Shader.h"
+#include "Platform.h"
 
 #define LOG_SIZE 512
 
 using namespace std;
+using namespace std::chrono;
 
-Shader::Shader(const char *vertex_file, const char *fragment_file)
+struct ProgramBinaryHeader
 {
-	unsigned int vertex_shader = Compile(GL_VERTEX_SHADER, vertex_file);
-	unsigned int fragment_shader = Compile(GL_FRAGMENT_SHADER, fragment_file);
-		
-	shader_program = glCreateProgram();
-	Link(vertex_shader, fragment_shader);
+	char magic[4];
+	unsigned int format;
+	unsigned long long key;
+	int length;
+};
+
+Shader::Shader(const char *vertex_file, const char *fragment_file, const ShaderOptions &options)
+{
+	auto start = high_resolution_clock::now();
+
+	// a truncated source would only fail later with a confusing glsl error
+	string vertex_source, fragment_source;
+	if (!Preprocess(vertex_file, options, vertex_source) || !Preprocess(fragment_file, options, fragment_source))
+	{
+		std::cout << fragment_file << " not compiled" << std::endl;
+		return;
+	}
+	source_hash = Hash(fragment_source.c_str(), Hash(vertex_source.c_str(), 14695981039346656037ull));
+	unsigned long long key = Hash(fragment_source.c_str(), Hash(vertex_source.c_str(), DriverHash()));
+	string cache_file = CacheFile(fragment_file);
+
+	bool cached = LoadBinary(cache_file.c_str(), key);
+	if (!cached)
+	{
+		unsigned int vertex_shader = Compile(GL_VERTEX_SHADER, vertex_file, vertex_source.c_str());
+		unsigned int fragment_shader = Compile(GL_FRAGMENT_SHADER, fragment_file, fragment_source.c_str());
 
-	glDeleteShader(vertex_shader);
-	glDeleteShader(fragment_shader);
+		shader_program = glCreateProgram();
+		glProgramParameteri(shader_program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		Link(vertex_shader, fragment_shader);
+
+		glDeleteShader(vertex_shader);
+		glDeleteShader(fragment_shader);
+		SaveBinary(cache_file.c_str(), key);
+	}
+	if (cached || IsLinked())
+		UpdateCacheIndex(fragment_file, cache_file);
+
+	std::cout << cache_file << (cached ? " loaded from cache in " : " compiled in ")
+		<< duration<double, milli>(high_resolution_clock::now() - start).count() << " ms" << std::endl;
 }
 
-Shader::Shader(const char *compute_file)
+Shader::Shader(const char *compute_file, const ShaderOptions &options)
 {
-	unsigned int compute_shader = Compile(GL_COMPUTE_SHADER, compute_file);
+	auto start = high_resolution_clock::now();
 
-	shader_program = glCreateProgram();
-	Link(compute_shader);
+	string compute_source;
+	if (!Preprocess(compute_file, options, compute_source))
+	{
+		std::cout << compute_file << " not compiled" << std::endl;
+		return;
+	}
+	source_hash = Hash(compute_source.c_str(), 14695981039346656037ull);
+	unsigned long long key = Hash(compute_source.c_str(), DriverHash());
+	string cache_file = CacheFile(compute_file);
+
+	bool cached = LoadBinary(cache_file.c_str(), key);
+	if (!cached)
+	{
+		unsigned int compute_shader = Compile(GL_COMPUTE_SHADER, compute_file, compute_source.c_str());
+
+		shader_program = glCreateProgram();
+		glProgramParameteri(shader_program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		Link(compute_shader);
+
+		glDeleteShader(compute_shader);
+		SaveBinary(cache_file.c_str(), key);
+	}
+	if (cached || IsLinked())
+		UpdateCacheIndex(compute_file, cache_file);
 
-	glDeleteShader(compute_shader);
+	std::cout << cache_file << (cached ? " loaded from cache in " : " compiled in ")
+		<< duration<double, milli>(high_resolution_clock::now() - start).count() << " ms" << std::endl;
 }
 
 void Shader::Use()
@@ -37,28 +100,89 @@ int Shader::GetUniform(const char *param_name)
 	return glGetUniformLocation(shader_program, param_name);
 }
 
-void Shader::Load(const char *shader_file, char *source)
+bool Shader::IsLinked() const
 {
-	FILE *stream;
-	fopen_s(&stream, shader_file, "r");
-	if (stream != nullptr)
+	int success = 0;
+	if (shader_program != 0)
+		glGetProgramiv(shader_program, GL_LINK_STATUS, &success);
+	return success != 0;
+}
+
+bool Shader::Preprocess(const char *shader_file, const ShaderOptions &options, string &source, int depth)
+{
+	ifstream stream(shader_file);
+	if (!stream)
 	{
-		size_t size = fread(source, sizeof(char), MAX_SHADER_SIZE, stream);
-		source[size] = 0;
-		fclose(stream);
+		std::cout << "failed to open shader " << shader_file << std::endl;
+		return false;
 	}
+	// includes are relative to the including file
+	string path = shader_file;
+	string directory = path.substr(0, path.find_last_of("/\\") + 1);
+
+	string line;
+	int line_number = 0;
+	while (getline(stream, line))
+	{
+		line_number++;
+		if (!line.empty() && line.back() == '\r')
+			line.pop_back();
+		size_t start = line.find_first_not_of(" \t");
+		bool directive = start != string::npos && line[start] == '#';
+
+		if (directive && line.compare(start, 8, "#include") == 0)
+		{
+			size_t open = line.find('"', start);
+			size_t close = open != string::npos ? line.find('"', open + 1) : string::npos;
+			if (close == string::npos || depth >= MAX_INCLUDE_DEPTH)
+			{
+				std::cout << "invalid include at " << shader_file << ":" << line_number << std::endl;
+				return false;
+			}
+			string name = line.substr(open + 1, close - open - 1);
+			auto generated = options.includes.find(name);
+			source += "#line 1\n";
+			if (generated != options.includes.end())
+			{
+				source += generated->second;
+				source += "\n";
+			}
+			else if (!Preprocess((directory + name).c_str(), options, source, depth + 1))
+			{
+				return false;
+			}
+			source += "#line " + to_string(line_number + 1) + "\n";
+			continue;
+		}
+
+		source += line;
+		source += "\n";
+		if (depth == 0 && directive && line.compare(start, 8, "#version") == 0)
+		{
+			for (const auto &define : options.defines)
+			{
+				source += "#define " + define.first + " " + define.second + "\n";
+			}
+			source += "#line " + to_string(line_number + 1) + "\n";
+		}
+	}
+	return true;
+}
+
+string Shader::CacheFile(const char *shader_file) const
+{
+	char variant[32];
+	snprintf(variant, sizeof(variant), ".%08x", (unsigned int)(source_hash ^ (source_hash >> 32)));
+	return shader_file + string(variant) + SHADER_CACHE_EXTENSION;
 }
 
-unsigned int Shader::Compile(const int shader_type, const char *shader_file)
+unsigned int Shader::Compile(const int shader_type, const char *shader_file, const char *source)
 {
 	assert(shader_type == GL_VERTEX_SHADER || shader_type == GL_FRAGMENT_SHADER || shader_type == GL_COMPUTE_SHADER);
 
 	int success;
 	char info_log[LOG_SIZE];
 
-	char source[MAX_SHADER_SIZE];
-	Load(shader_file, source);
-
 	unsigned int shader;
 	shader = glCreateShader(shader_type);
 	const GLchar *const source_ptr = static_cast<const GLchar *const>(source);
@@ -107,4 +231,117 @@ void Shader::Link(const unsigned int compute_shader)
 		glGetProgramInfoLog(shader_program, LOG_SIZE, NULL, info_log);
 		std::cout << "compute shader program link failed" << info_log << std::endl;
 	}
-}
\ No newline at end of file
+}
+
+bool Shader::LoadBinary(const char *cache_file, unsigned long long key)
+{
+	FILE *stream = nullptr;
+	fopen_s(&stream, cache_file, "rb");
+	if (stream == nullptr)
+		return false;
+
+	ProgramBinaryHeader header;
+	std::string binary;
+	bool valid = fread(&header, sizeof(header), 1, stream) == 1
+		&& memcmp(header.magic, "L2DS", 4) == 0 && header.key == key && header.length > 0;
+	if (valid)
+	{
+		binary.resize(header.length);
+		valid = fread(&binary[0], 1, header.length, stream) == (size_t)header.length;
+	}
+	fclose(stream);
+	if (!valid)
+		return false;
+
+	// the driver may still reject a binary, e.g. after an update that kept the version string
+	shader_program = glCreateProgram();
+	glProgramBinary(shader_program, header.format, binary.data(), header.length);
+	int success;
+	glGetProgramiv(shader_program, GL_LINK_STATUS, &success);
+	if (!success)
+	{
+		Release();
+		return false;
+	}
+	return true;
+}
+
+void Shader::SaveBinary(const char *cache_file, unsigned long long key)
+{
+	int success;
+	glGetProgramiv(shader_program, GL_LINK_STATUS, &success);
+	ProgramBinaryHeader header = { { 'L', '2', 'D', 'S' }, 0, key, 0 };
+	glGetProgramiv(shader_program, GL_PROGRAM_BINARY_LENGTH, &header.length);
+	if (!success || header.length <= 0)
+		return;
+
+	std::string binary(header.length, 0);
+	GLenum format;
+	glGetProgramBinary(shader_program, header.length, &header.length, &format, &binary[0]);
+	header.format = format;
+
+	FILE *stream = nullptr;
+	fopen_s(&stream, cache_file, "wb");
+	if (stream == nullptr)
+		return;
+	fwrite(&header, sizeof(header), 1, stream);
+	fwrite(binary.data(), 1, header.length, stream);
+	fclose(stream);
+}
+
+void Shader::UpdateCacheIndex(const char *shader_file, const string &cache_file)
+{
+	// first line is the driver that built the listed binaries
+	string index_file = shader_file + string(SHADER_CACHE_INDEX);
+	unsigned long long driver = DriverHash();
+	unsigned long long indexed_driver = 0;
+	vector<string> entries;
+	ifstream index(index_file);
+	string line;
+	if (index >> hex >> indexed_driver && getline(index, line))
+	{
+		while (getline(index, line))
+		{
+			if (!line.empty() && line != cache_file)
+				entries.push_back(line);
+		}
+	}
+	index.close();
+
+	// binaries of another driver never load again, the least recently used variants make room
+	size_t keep = indexed_driver == driver ? min(entries.size(), (size_t)SHADER_CACHE_VARIANTS - 1) : 0;
+	for (size_t i = keep; i < entries.size(); i++)
+	{
+		remove(entries[i].c_str());
+	}
+	entries.resize(keep);
+
+	ofstream stream(index_file, ios::trunc);
+	stream << hex << driver << endl << cache_file << endl;
+	for (const string &entry : entries)
+	{
+		stream << entry << endl;
+	}
+}
+
+unsigned long long Shader::Hash(const char *text, unsigned long long hash)
+{
+	// fnv-1a
+	for (const char *c = text; *c != 0; c++)
+	{
+		hash = (hash ^ (unsigned char)*c) * 1099511628211ull;
+	}
+	return hash;
+}
+
+unsigned long long Shader::DriverHash()
+{
+	unsigned long long hash = 14695981039346656037ull;
+	GLenum names[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+	for (GLenum name : names)
+	{
+		const char *value = (const char *)glGetString(name);
+		hash = Hash(value != nullptr ? value : "", hash);
+	}
+	return hash;
+}
@@ -1,19 +1,40 @@
 #pragma once
 #include <glad/glad.h>
 #include <iostream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
 
-#define MAX_SHADER_SIZE 16384 // single shader file cannot exceed 16 kb
+// linked programs are cached next to the last shader file, one file per variant,
+// e.g. shader/ray.frag.0123abcd.bin, listed most recently used first in shader/ray.frag.cache
+// so binaries of another driver and the least recently used variants can be deleted
+#define SHADER_CACHE_EXTENSION ".bin"
+#define SHADER_CACHE_INDEX ".cache"
+#define SHADER_CACHE_VARIANTS 16 // binaries kept per shader file
+#define MAX_INCLUDE_DEPTH 16
+
+// specialisation of a shader, each distinct set of options is compiled and cached separately
+struct ShaderOptions
+{
+	// #define name value lines inserted after #version
+	std::vector<std::pair<std::string, std::string>> defines;
+	// generated sources resolved by #include "name" before looking for a file
+	std::map<std::string, std::string> includes;
+};
 
 class Shader
 {
 public:
-	Shader(const char *vertex_file, const char *fragment_file);
-	Shader(const char *compute_file);
+	// empty program, a compiled shader must be assigned before use
+	Shader() { };
+	Shader(const char *vertex_file, const char *fragment_file, const ShaderOptions &options = ShaderOptions());
+	Shader(const char *compute_file, const ShaderOptions &options = ShaderOptions());
 	// remove copy constructor/assignment
 	Shader(const Shader &) = delete;
 	Shader &operator=(const Shader &) = delete;
 	// define move constructor/assignment
-	Shader(Shader &&shader) : shader_program(shader.shader_program)
+	Shader(Shader &&shader) : shader_program(shader.shader_program), source_hash(shader.source_hash)
 	{
 		shader.shader_program = 0;
 	}
@@ -24,7 +45,9 @@ public:
 			// release prev shader
 			Release();
 			std::swap(shader_program, shader.shader_program);
+			std::swap(source_hash, shader.source_hash);
 		}
+		return *this;
 	}
 	// release shader on destruct
 	~Shader()
@@ -34,9 +57,14 @@ public:
 
 	void Use();
 	int GetUniform(const char *param_name);
+	// false if compiling or linking failed
+	bool IsLinked() const;
+	// hash of the preprocessed sources, identifies the variant independent of the driver
+	unsigned long long GetSourceHash() const { return source_hash; }
 
 private:
 	unsigned int shader_program = 0;
+	unsigned long long source_hash = 0;
 
 	void Release()
 	{
@@ -44,8 +72,18 @@ private:
 		shader_program = 0;
 	}
 
-	void Load(const char *shader_file, char *source);
-	unsigned int Compile(const int shader_type, const char *shader_file);
+	// append the file to source resolving #include and inserting the defines after #version
+	bool Preprocess(const char *shader_file, const ShaderOptions &options, std::string &source, int depth = 0);
+	std::string CacheFile(const char *shader_file) const;
+	unsigned int Compile(const int shader_type, const char *shader_file, const char *source);
 	void Link(const unsigned int vertex_shader, const unsigned int fragment_shader);
 	void Link(const unsigned int compute_shader);
+
+	// the cache key covers the sources and the driver, a binary from another driver version is stale
+	bool LoadBinary(const char *cache_file, unsigned long long key);
+	void SaveBinary(const char *cache_file, unsigned long long key);
+	// move the binary to the front of the shader file's index and delete stale ones
+	static void UpdateCacheIndex(const char *shader_file, const std::string &cache_file);
+	static unsigned long long Hash(const char *text, unsigned long long hash);
+	static unsigned long long DriverHash();
 };
\ No newline at end of file
@@ -0,0 +1,285 @@
+#include <glad/glad.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Trace.h"
+
+using namespace std;
+using namespace std::chrono;
+
+struct TraceEvent
+{
+	const char *name;
+	long long start, end;
+};
+
+// ring entry, Dump copies entries while their owner may overwrite them
+struct TraceSlot
+{
+	atomic<const char *> name;
+	atomic<long long> start, end;
+};
+
+struct TraceBuffer
+{
+	int id;
+	string name;
+	TraceSlot events[TRACE_EVENTS];
+	// events ever recorded, only the owning thread advances it
+	atomic<unsigned long long> head{ 0 };
+	// head when the current trace started, moved by Enable instead of resetting head under its owner
+	atomic<unsigned long long> first{ 0 };
+};
+
+// a timestamp query pair around one gpu pass
+struct GpuQuery
+{
+	const char *name;
+	unsigned int begin, end;
+	bool ended;
+};
+
+// gives the buffer of an exiting thread to the next new one
+struct TraceBufferHolder
+{
+	TraceBuffer *buffer = nullptr;
+	~TraceBufferHolder();
+};
+
+static atomic<bool> enabled{ false };
+static const steady_clock::time_point trace_start = steady_clock::now();
+// events ending before the current trace started belong to the previous one
+static atomic<long long> trace_begin{ 0 };
+
+static mutex registry_mutex;
+static vector<unique_ptr<TraceBuffer>> buffers;
+static vector<TraceBuffer *> free_buffers;
+static thread_local TraceBufferHolder local_buffer;
+
+// gl thread only, the gpu track is tid 0
+static TraceBuffer gpu_buffer;
+static GpuQuery gpu_queries[TRACE_GPU_QUERIES];
+static unsigned long long gpu_head = 0, gpu_tail = 0;
+static bool gpu_created = false;
+// trace clock minus gl timestamp
+static long long gpu_offset = 0;
+
+TraceBufferHolder::~TraceBufferHolder()
+{
+	if (buffer == nullptr)
+		return;
+	lock_guard<mutex> lock(registry_mutex);
+	free_buffers.push_back(buffer);
+}
+
+static TraceBuffer *GetBuffer(const char *name = "")
+{
+	if (local_buffer.buffer == nullptr)
+	{
+		// continue the track of a finished thread of the same name
+		lock_guard<mutex> lock(registry_mutex);
+		auto found = find_if(free_buffers.begin(), free_buffers.end(), [name](TraceBuffer *buffer) { return buffer->name == name; });
+		if (found != free_buffers.end())
+		{
+			local_buffer.buffer = *found;
+			free_buffers.erase(found);
+		}
+		else
+		{
+			buffers.emplace_back(new TraceBuffer());
+			buffers.back()->id = (int)buffers.size();
+			buffers.back()->name = name;
+			local_buffer.buffer = buffers.back().get();
+		}
+	}
+	return local_buffer.buffer;
+}
+
+static void Push(TraceBuffer &buffer, const char *name, long long start, long long end)
+{
+	unsigned long long head = buffer.head.load(memory_order_relaxed);
+	TraceSlot &slot = buffer.events[head % TRACE_EVENTS];
+	slot.name.store(name, memory_order_relaxed);
+	slot.start.store(start, memory_order_relaxed);
+	slot.end.store(end, memory_order_relaxed);
+	buffer.head.store(head + 1, memory_order_release);
+}
+
+void Trace::Enable(bool enable)
+{
+	if (enable)
+	{
+		// drop the previous trace, workers may still be recording so their heads only move forward
+		enabled = false;
+		CollectGpu(true);
+		{
+			lock_guard<mutex> lock(registry_mutex);
+			for (auto &buffer : buffers)
+				buffer->first = buffer->head.load();
+		}
+		gpu_buffer.first = gpu_buffer.head.load();
+		trace_begin = Now();
+
+		if (!gpu_created)
+		{
+			for (GpuQuery &query : gpu_queries)
+			{
+				glGenQueries(1, &query.begin);
+				glGenQueries(1, &query.end);
+			}
+			gpu_created = true;
+		}
+		GLint64 timestamp;
+		glGetInteger64v(GL_TIMESTAMP, &timestamp);
+		gpu_offset = Now() - timestamp;
+	}
+	enabled = enable;
+}
+
+bool Trace::IsEnabled()
+{
+	return enabled.load(memory_order_relaxed);
+}
+
+void Trace::SetThreadName(const char *name)
+{
+	if (local_buffer.buffer == nullptr)
+	{
+		GetBuffer(name);
+		return;
+	}
+	lock_guard<mutex> lock(registry_mutex);
+	local_buffer.buffer->name = name;
+}
+
+long long Trace::Now()
+{
+	return duration_cast<nanoseconds>(steady_clock::now() - trace_start).count();
+}
+
+void Trace::Record(const char *name, long long start, long long end)
+{
+	if (!IsEnabled())
+		return;
+	Push(*GetBuffer(), name, start, end);
+}
+
+int Trace::BeginGpu(const char *name)
+{
+	if (!IsEnabled())
+		return -1;
+	// read back what has finished before the pool runs out, passes are dropped while it is full
+	if (gpu_head - gpu_tail >= TRACE_GPU_QUERIES / 2)
+		CollectGpu();
+	if (gpu_head - gpu_tail >= TRACE_GPU_QUERIES)
+		return -1;
+
+	int index = (int)(gpu_head++ % TRACE_GPU_QUERIES);
+	GpuQuery &query = gpu_queries[index];
+	query.name = name;
+	query.ended = false;
+	glQueryCounter(query.begin, GL_TIMESTAMP);
+	return index;
+}
+
+void Trace::EndGpu(int query)
+{
+	if (query < 0)
+		return;
+	glQueryCounter(gpu_queries[query].end, GL_TIMESTAMP);
+	gpu_queries[query].ended = true;
+}
+
+void Trace::CollectGpu(bool wait)
+{
+	// queries finish in issue order
+	while (gpu_tail < gpu_head)
+	{
+		GpuQuery &query = gpu_queries[gpu_tail % TRACE_GPU_QUERIES];
+		if (!query.ended)
+			break;
+		if (!wait)
+		{
+			GLint available = 0;
+			glGetQueryObjectiv(query.end, GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available)
+				break;
+		}
+		GLuint64 begin, end;
+		glGetQueryObjectui64v(query.begin, GL_QUERY_RESULT, &begin);
+		glGetQueryObjectui64v(query.end, GL_QUERY_RESULT, &end);
+		Push(gpu_buffer, query.name, (long long)begin + gpu_offset, (long long)end + gpu_offset);
+		gpu_tail++;
+	}
+}
+
+bool Trace::Dump(const char *json_file)
+{
+	CollectGpu(true);
+
+	ofstream stream(json_file);
+	if (!stream)
+	{
+		cout << "failed to open " << json_file << endl;
+		return false;
+	}
+
+	// trace event timestamps are microseconds
+	size_t count = 0;
+	auto write_buffer = [&](const TraceBuffer &buffer, int id, const string &name)
+	{
+		stream << (count++ > 0 ? ",\n" : "\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << id
+			<< ",\"args\":{\"name\":\"" << name << "\"}}";
+
+		// the owner may overwrite the oldest events while they are copied, those are dropped
+		unsigned long long head = buffer.head.load(memory_order_acquire);
+		unsigned long long first = max(buffer.first.load(), head > TRACE_EVENTS ? head - TRACE_EVENTS : 0);
+		vector<TraceEvent> events;
+		for (unsigned long long i = first; i < head; i++)
+		{
+			const TraceSlot &slot = buffer.events[i % TRACE_EVENTS];
+			events.push_back({ slot.name.load(memory_order_relaxed), slot.start.load(memory_order_relaxed),
+				slot.end.load(memory_order_relaxed) });
+		}
+		atomic_thread_fence(memory_order_acquire);
+		unsigned long long after = buffer.head.load(memory_order_relaxed);
+		unsigned long long valid = after >= TRACE_EVENTS ? after - TRACE_EVENTS + 1 : 0;
+		size_t skip = valid > first ? (size_t)min(valid - first, head - first) : 0;
+
+		long long begin = trace_begin.load();
+		for (size_t i = skip; i < events.size(); i++)
+		{
+			const TraceEvent &event = events[i];
+			// recorded by a thread that saw tracing on just before the trace restarted
+			if (event.end < begin)
+				continue;
+			stream << ",\n{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << id
+				<< ",\"ts\":" << event.start / 1e3 << ",\"dur\":" << (event.end - event.start) / 1e3 << "}";
+		}
+	};
+
+	stream.precision(15);
+	stream << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	write_buffer(gpu_buffer, 0, "GPU");
+	{
+		lock_guard<mutex> lock(registry_mutex);
+		for (auto &buffer : buffers)
+			write_buffer(*buffer, buffer->id, buffer->name.empty() ? "thread " + to_string(buffer->id) : buffer->name);
+	}
+	stream << "\n]}" << endl;
+
+	if (!stream)
+	{
+		cout << "failed to write " << json_file << endl;
+		return false;
+	}
+	cout << "Trace written to " << json_file << endl;
+	return true;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#define TRACE_EVENTS 16384 // events kept per thread, older ones are overwritten
+#define TRACE_GPU_QUERIES 256 // timed gpu passes whose queries have not been read back yet
+#define TRACE_FILE "light2d.trace.json" // written by the T key in interactive mode
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+// time the rest of the enclosing scope on the calling thread, names must be string literals
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(trace_scope_, __LINE__)(name)
+// time the gl commands issued in the rest of the enclosing scope, gl thread only
+#define TRACE_GPU_SCOPE(name) GpuTraceScope TRACE_CONCAT(gpu_trace_scope_, __LINE__)(name)
+
+// records scoped events into per thread ring buffers and gpu passes through timestamp queries,
+// and dumps them as chrome trace json for chrome://tracing or ui.perfetto.dev.
+// every thread only writes its own buffer so recording takes no locks, buffers of finished
+// threads are handed to the next new thread so short lived workers share a few tracks
+class Trace
+{
+public:
+	// enabling starts a new trace, call on the gl thread, threads still recording need not stop
+	static void Enable(bool enable);
+	static bool IsEnabled();
+	// name of the calling thread's track
+	static void SetThreadName(const char *name);
+	// nanoseconds on the trace clock
+	static long long Now();
+	static void Record(const char *name, long long start, long long end);
+
+	// returns the query pair used or -1 when not tracing
+	static int BeginGpu(const char *name);
+	static void EndGpu(int query);
+	// move finished gpu passes to the gpu track, wait blocks until all issued ones are done
+	static void CollectGpu(bool wait = false);
+
+	// write all events still held, call on the gl thread
+	static bool Dump(const char *json_file);
+};
+
+class TraceScope
+{
+public:
+	TraceScope(const char *name) : name(name), start(Trace::Now()) { };
+	~TraceScope() { Trace::Record(name, start, Trace::Now()); };
+
+private:
+	const char *name;
+	long long start;
+};
+
+class GpuTraceScope
+{
+public:
+	GpuTraceScope(const char *name) : query(Trace::BeginGpu(name)) { };
+	~GpuTraceScope() { Trace::EndGpu(query); };
+
+private:
+	int query;
+};